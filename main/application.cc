@@ -10,6 +10,7 @@
 #include "iot/thing_manager.h"
 #include "assets/lang_config.h"
 #include "mcp_server.h"
+#include "rule_engine.h"
 #include "audio_debugger.h"
 
 #if CONFIG_USE_AUDIO_PROCESSOR
@@ -109,7 +110,7 @@ void Application::CheckNewVersion(Ota& ota) {
     while (true) {
         SetDeviceState(kDeviceStateActivating);
         auto display = Board::GetInstance().GetDisplay();
-        display->SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
+        display->PostStatus(Lang::Strings::CHECKING_NEW_VERSION);
 
         if (!ota.CheckVersion()) {
             retry_count++;
@@ -144,7 +145,7 @@ void Application::CheckNewVersion(Ota& ota) {
             
             display->SetIcon(FONT_AWESOME_DOWNLOAD);
             std::string message = std::string(Lang::Strings::NEW_VERSION) + ota.GetFirmwareVersion();
-            display->SetChatMessage("system", message.c_str());
+            display->PostChatMessage("system", message.c_str());
 
             auto& board = Board::GetInstance();
             board.SetPowerSaveMode(false);
@@ -165,11 +166,11 @@ void Application::CheckNewVersion(Ota& ota) {
             ota.StartUpgrade([display](int progress, size_t speed) {
                 char buffer[64];
                 snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
-                display->SetChatMessage("system", buffer);
+                display->PostChatMessage("system", buffer);
             });
 
             // If upgrade success, the device will reboot and never reach here
-            display->SetStatus(Lang::Strings::UPGRADE_FAILED);
+            display->PostStatus(Lang::Strings::UPGRADE_FAILED);
             ESP_LOGI(TAG, "Firmware upgrade failed...");
             vTaskDelay(pdMS_TO_TICKS(3000));
             Reboot();
@@ -184,7 +185,7 @@ void Application::CheckNewVersion(Ota& ota) {
             break;
         }
 
-        display->SetStatus(Lang::Strings::ACTIVATION);
+        display->PostStatus(Lang::Strings::ACTIVATION);
         // Activation code is shown to the user and waiting for the user to input
         if (ota.HasActivationCode()) {
             ShowActivationCode(ota.GetActivationCode(), ota.GetActivationMessage());
@@ -242,9 +243,11 @@ void Application::ShowActivationCode(const std::string& code, const std::string&
 void Application::Alert(const char* status, const char* message, const char* emotion, const std::string_view& sound) {
     ESP_LOGW(TAG, "Alert %s: %s [%s]", status, message, emotion);
     auto display = Board::GetInstance().GetDisplay();
-    display->SetStatus(status);
-    display->SetEmotion(emotion);
-    display->SetChatMessage("system", message);
+    display->PostStatus(status);
+    // The status no longer shows the idle clock, post it again on the next tick
+    clock_minute_ = -1;
+    display->PostEmotion(emotion);
+    display->PostChatMessage("system", message);
     if (!sound.empty()) {
         ResetDecoder();
         PlaySound(sound);
@@ -254,9 +257,10 @@ void Application::Alert(const char* status, const char* message, const char* emo
 void Application::DismissAlert() {
     if (device_state_ == kDeviceStateIdle) {
         auto display = Board::GetInstance().GetDisplay();
-        display->SetStatus(Lang::Strings::STANDBY);
-        display->SetEmotion("neutral");
-        display->SetChatMessage("system", "");
+        display->PostStatus(Lang::Strings::STANDBY);
+        clock_minute_ = -1;
+        display->PostEmotion("neutral");
+        display->PostChatMessage("system", "");
     }
 }
 
@@ -456,11 +460,19 @@ void Application::Start() {
     CheckNewVersion(ota);
 
     // Initialize the protocol
-    display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
+    display->PostStatus(Lang::Strings::LOADING_PROTOCOL);
 
     // Add MCP common tools before initializing the protocol
 #if CONFIG_IOT_PROTOCOL_MCP
     McpServer::GetInstance().AddCommonTools();
+    RuleEngine::GetInstance().Initialize();
+    // Tools may change the device status that the rules depend on
+    McpServer::GetInstance().OnToolCallCompleted([]() {
+        RuleEngine::GetInstance().Notify();
+    });
+#if CONFIG_MCP_SERVER_BENCHMARK
+    McpServer::GetInstance().RunBenchmark();
+#endif
 #endif
 
     if (ota.HasMqttConfig()) {
@@ -483,6 +495,7 @@ void Application::Start() {
                 STATE_STRINGS[device_state_]);
         
         std::lock_guard<std::mutex> lock(mutex_);
+        packet.sequence = ++incoming_audio_sequence_;
         
         if (device_state_ == kDeviceStateSpeaking || web_control_panel_active_) {
             if (audio_decode_queue_.size() >= MAX_AUDIO_PACKETS_IN_QUEUE) {
@@ -508,18 +521,24 @@ void Application::Start() {
 
 #if CONFIG_IOT_PROTOCOL_XIAOZHI
         auto& thing_manager = iot::ThingManager::GetInstance();
-        protocol_->SendIotDescriptors(thing_manager.GetDescriptorsJson());
-        std::string states;
-        if (thing_manager.GetStatesJson(states, false)) {
-            protocol_->SendIotStates(states);
-        }
+        protocol_->SendIotDescriptors(thing_manager.GetDescriptors());
+        // The reported states are also updated by the delta reports, which run on the main loop
+        Schedule([this]() {
+            if (!protocol_ || !protocol_->IsAudioChannelOpened()) {
+                return;
+            }
+            std::string states;
+            if (iot::ThingManager::GetInstance().GetStatesJson(states, false)) {
+                protocol_->SendIotStates(states);
+            }
+        });
 #endif
     });
     protocol_->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
         Schedule([this]() {
             auto display = Board::GetInstance().GetDisplay();
-            display->SetChatMessage("system", "");
+            display->PostChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
         });
     });
@@ -694,9 +713,18 @@ void Application::Start() {
                 auto text = cJSON_GetObjectItem(root, "text");
                 if (cJSON_IsString(text)) {
                     ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
-                    });
+                    // The sentence's audio follows this message on the same connection
+                    uint32_t sequence;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        sequence = incoming_audio_sequence_ + 1;
+                    }
+                    std::lock_guard<std::mutex> lock(subtitle_mutex_);
+                    if (pending_subtitles_.size() >= MAX_PENDING_SUBTITLES) {
+                        display->PostChatMessage("assistant", pending_subtitles_.front().text.c_str());
+                        pending_subtitles_.pop_front();
+                    }
+                    pending_subtitles_.push_back({sequence, esp_timer_get_time(), text->valuestring});
                 }
             }
         } else if (strcmp(type->valuestring, "stt") == 0) {
@@ -732,14 +760,14 @@ void Application::Start() {
                 }
 #endif
                 Schedule([this, display, message = std::string(text->valuestring)]() {
-                    display->SetChatMessage("user", message.c_str());
+                    display->PostChatMessage("user", message.c_str());
                 });
             }
         } else if (strcmp(type->valuestring, "llm") == 0) {
             auto emotion = cJSON_GetObjectItem(root, "emotion");
             if (cJSON_IsString(emotion)) {
                 Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
+                    display->PostEmotion(emotion_str.c_str());
                 });
             }
 #if CONFIG_IOT_PROTOCOL_MCP
@@ -751,7 +779,7 @@ void Application::Start() {
             ESP_LOGI(TAG, "MCP activity detected, will suppress bells for next 3 seconds");
 #endif
             auto payload = cJSON_GetObjectItem(root, "payload");
-            if (cJSON_IsObject(payload)) {
+            if (cJSON_IsObject(payload) || cJSON_IsArray(payload)) {
                 McpServer::GetInstance().ParseMessage(payload);
             }
 #endif
@@ -899,8 +927,8 @@ void Application::Start() {
     has_server_time_ = ota.HasServerTime();
     if (protocol_started) {
         std::string message = std::string(Lang::Strings::VERSION) + ota.GetCurrentVersion();
-        display->ShowNotification(message.c_str());
-        display->SetChatMessage("system", "");
+        display->PostNotification(message.c_str());
+        display->PostChatMessage("system", "");
         // Play the success sound to indicate the device is ready
         ResetDecoder();
 #ifdef CONFIG_BOARD_TYPE_HEYSANTA
@@ -928,18 +956,24 @@ void Application::OnClockTimer() {
         // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
         // SystemInfo::PrintTaskList();
         SystemInfo::PrintHeapStats();
+#if CONFIG_IOT_PROTOCOL_MCP
+        RuleEngine::GetInstance().CheckBattery();
+#endif
+    }
 
-        // If we have synchronized server time, set the status to clock "HH:MM" if the device is idle
-        if (has_server_time_) {
-            if (device_state_ == kDeviceStateIdle) {
-                Schedule([this]() {
-                    // Set status to clock "HH:MM"
-                    time_t now = time(NULL);
-                    char time_str[64];
-                    strftime(time_str, sizeof(time_str), "%H:%M  ", localtime(&now));
-                    Board::GetInstance().GetDisplay()->SetStatus(time_str);
-                });
-            }
+    // If we have synchronized server time, set the status to clock "HH:MM" 10 seconds after the device becomes idle,
+    // then only when the minute changes
+    if (has_server_time_ && device_state_ == kDeviceStateIdle && clock_ticks_ >= 10) {
+        time_t now = time(NULL);
+        int minute = now / 60;
+        if (minute != clock_minute_) {
+            clock_minute_ = minute;
+            // Set status to clock "HH:MM"
+            struct tm timeinfo;
+            localtime_r(&now, &timeinfo);
+            char time_str[64];
+            strftime(time_str, sizeof(time_str), "%H:%M  ", &timeinfo);
+            Board::GetInstance().GetDisplay()->PostStatus(time_str);
         }
     }
 }
@@ -1078,6 +1112,9 @@ void Application::OnAudioOutput() {
             pcm = std::move(resampled);
         }
         codec->OutputData(pcm);
+        if (packet.sequence != 0) {
+            ShowSubtitles(packet.sequence);
+        }
 #ifdef CONFIG_USE_SERVER_AEC
         std::lock_guard<std::mutex> ts_lock(timestamp_mutex_);
         timestamp_queue_.push_back(packet.timestamp);
@@ -1086,6 +1123,27 @@ void Application::OnAudioOutput() {
     });
 }
 
+// Called by the decode task after a packet is written to the codec
+void Application::ShowSubtitles(uint32_t played_sequence) {
+    auto display = Board::GetInstance().GetDisplay();
+    std::lock_guard<std::mutex> lock(subtitle_mutex_);
+    while (!pending_subtitles_.empty() && (int32_t)(played_sequence - pending_subtitles_.front().sequence) >= 0) {
+        auto& subtitle = pending_subtitles_.front();
+        ESP_LOGD(TAG, "Subtitle shown %d ms after it arrived", (int)((esp_timer_get_time() - subtitle.arrival_time) / 1000));
+        display->PostChatMessage("assistant", subtitle.text.c_str());
+        pending_subtitles_.pop_front();
+    }
+}
+
+void Application::FlushSubtitles() {
+    auto display = Board::GetInstance().GetDisplay();
+    std::lock_guard<std::mutex> lock(subtitle_mutex_);
+    for (auto& subtitle : pending_subtitles_) {
+        display->PostChatMessage("assistant", subtitle.text.c_str());
+    }
+    pending_subtitles_.clear();
+}
+
 void Application::OnAudioInput() {
     if (device_state_ == kDeviceStateAudioTesting) {
         if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
@@ -1192,12 +1250,28 @@ void Application::SetListeningMode(ListeningMode mode) {
     SetDeviceState(kDeviceStateListening);
 }
 
+// LVGL 刷新周期：空闲时只有时钟变化，降低刷新率；录音和播放时让出 CPU 给音频编解码
+static int GetDisplayRefreshPeriod(DeviceState state) {
+    switch (state) {
+        case kDeviceStateIdle:
+            return 100;
+        case kDeviceStateListening:
+        case kDeviceStateSpeaking:
+            return 50;
+        case kDeviceStateUpgrading:
+            return 200;
+        default:
+            return LV_DEF_REFR_PERIOD;
+    }
+}
+
 void Application::SetDeviceState(DeviceState state) {
     if (device_state_ == state) {
         return;
     }
     
     clock_ticks_ = 0;
+    clock_minute_ = -1;
     auto previous_state = device_state_;
     device_state_ = state;
     ESP_LOGI(TAG, "STATE: %s", STATE_STRINGS[device_state_]);
@@ -1208,23 +1282,28 @@ void Application::SetDeviceState(DeviceState state) {
     auto display = board.GetDisplay();
     auto led = board.GetLed();
     led->OnStateChanged();
+    display->SetRefreshPeriod(GetDisplayRefreshPeriod(state));
+    if (previous_state == kDeviceStateSpeaking) {
+        // Sentences whose audio never played are still shown
+        FlushSubtitles();
+    }
     switch (state) {
         case kDeviceStateUnknown:
         case kDeviceStateIdle:
-            display->SetStatus(Lang::Strings::STANDBY);
-            display->SetEmotion("neutral");
+            display->PostStatus(Lang::Strings::STANDBY);
+            display->PostEmotion("neutral");
             audio_processor_->Stop();
             wake_word_->StartDetection();
             break;
         case kDeviceStateConnecting:
-            display->SetStatus(Lang::Strings::CONNECTING);
-            display->SetEmotion("neutral");
-            display->SetChatMessage("system", "");
+            display->PostStatus(Lang::Strings::CONNECTING);
+            display->PostEmotion("neutral");
+            display->PostChatMessage("system", "");
             timestamp_queue_.clear();
             break;
         case kDeviceStateListening:
-            display->SetStatus(Lang::Strings::LISTENING);
-            display->SetEmotion("neutral");
+            display->PostStatus(Lang::Strings::LISTENING);
+            display->PostEmotion("neutral");
             // Update the IoT states before sending the start listening command
 #if CONFIG_IOT_PROTOCOL_XIAOZHI
             UpdateIotStates();
@@ -1246,7 +1325,7 @@ void Application::SetDeviceState(DeviceState state) {
             }
             break;
         case kDeviceStateSpeaking:
-            display->SetStatus(Lang::Strings::SPEAKING);
+            display->PostStatus(Lang::Strings::SPEAKING);
 
             if (listening_mode_ != kListeningModeRealtime) {
                 audio_processor_->Stop();
@@ -1309,6 +1388,10 @@ void Application::SetDecodeSampleRate(int sample_rate, int frame_duration) {
 
 void Application::UpdateIotStates() {
 #if CONFIG_IOT_PROTOCOL_XIAOZHI
+    // Keep the changes for the next session if the channel is closed
+    if (!protocol_ || !protocol_->IsAudioChannelOpened()) {
+        return;
+    }
     auto& thing_manager = iot::ThingManager::GetInstance();
     std::string states;
     if (thing_manager.GetStatesJson(states, true)) {
@@ -1356,7 +1439,7 @@ bool Application::CanEnterSleepMode() {
     return true;
 }
 
-void Application::SendMcpMessage(const std::string& payload) {
+void Application::SendMcpMessage(std::string payload) {
     ESP_LOGI(TAG, "=== SendMcpMessage called ===");
     ESP_LOGI(TAG, "Payload: %s", payload.c_str());
     ESP_LOGI(TAG, "Protocol pointer: %p", (void*)protocol_.get());
@@ -1368,7 +1451,7 @@ void Application::SendMcpMessage(const std::string& payload) {
     ESP_LOGI(TAG, "MCP message sent, will suppress bells for next 3 seconds");
 #endif
     
-    background_task_->Schedule([this, payload]() {
+    background_task_->Schedule([this, payload = std::move(payload)]() {
         ESP_LOGI(TAG, "=== Inside SendMcpMessage background task ===");
         ESP_LOGI(TAG, "Protocol pointer in task: %p", (void*)protocol_.get());
         
@@ -1394,15 +1477,15 @@ void Application::SetAecMode(AecMode mode) {
         switch (aec_mode_) {
         case kAecOff:
             audio_processor_->EnableDeviceAec(false);
-            display->ShowNotification(Lang::Strings::RTC_MODE_OFF);
+            display->PostNotification(Lang::Strings::RTC_MODE_OFF);
             break;
         case kAecOnServerSide:
             audio_processor_->EnableDeviceAec(false);
-            display->ShowNotification(Lang::Strings::RTC_MODE_ON);
+            display->PostNotification(Lang::Strings::RTC_MODE_ON);
             break;
         case kAecOnDeviceSide:
             audio_processor_->EnableDeviceAec(true);
-            display->ShowNotification(Lang::Strings::RTC_MODE_ON);
+            display->PostNotification(Lang::Strings::RTC_MODE_ON);
             break;
         }
 
@@ -51,6 +51,7 @@ enum DeviceState {
 #define OPUS_FRAME_DURATION_MS 60
 #define MAX_AUDIO_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
+#define MAX_PENDING_SUBTITLES 16
 
 class Application {
 public:
@@ -81,7 +82,7 @@ public:
     bool IsWebControlPanelActive() const;
     void PlaySound(const std::string_view& sound);
     bool CanEnterSleepMode();
-    void SendMcpMessage(const std::string& payload);
+    void SendMcpMessage(std::string payload);
     void SetAecMode(AecMode mode);
     AecMode GetAecMode() const { return aec_mode_; }
     BackgroundTask* GetBackgroundTask() const { return background_task_; }
@@ -108,6 +109,7 @@ private:
     bool voice_detected_ = false;
     bool busy_decoding_audio_ = false;
     int clock_ticks_ = 0;
+    int clock_minute_ = -1;  // The minute shown by the status clock
     TaskHandle_t check_new_version_task_handle_ = nullptr;
 
     // Audio encode / decode
@@ -123,6 +125,16 @@ private:
     std::list<uint32_t> timestamp_queue_;
     std::mutex timestamp_mutex_;
 
+    // 字幕在句子的第一个音频包开始播放时显示
+    struct PendingSubtitle {
+        uint32_t sequence;  // Sequence of the first audio packet of the sentence
+        int64_t arrival_time;
+        std::string text;
+    };
+    std::list<PendingSubtitle> pending_subtitles_;
+    std::mutex subtitle_mutex_;
+    uint32_t incoming_audio_sequence_ = 0;
+
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
 
@@ -135,6 +147,8 @@ private:
     void OnAudioOutput();
     bool ReadAudio(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
+    void ShowSubtitles(uint32_t played_sequence);
+    void FlushSubtitles();
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckNewVersion(Ota& ota);
     void ShowActivationCode(const std::string& code, const std::string& message);
@@ -1,6 +1,7 @@
 #include "audio_codec.h"
 #include "board.h"
 #include "settings.h"
+#include "iot/thing_manager.h"
 
 #include <esp_log.h>
 #include <cstring>
@@ -48,6 +49,8 @@ void AudioCodec::SetOutputVolume(int volume) {
     
     Settings settings("audio", true);
     settings.SetInt("output_volume", output_volume_);
+    // 音量按键等不经过 IoT 方法的修改也立即上报
+    iot::ThingManager::GetInstance().NotifyPropertyChanged("AudioSpeaker", "volume");
 }
 
 void AudioCodec::EnableInput(bool enable) {
@@ -566,6 +566,7 @@ private:
     {
         for (int i = 1 ; i <= 3; i++) // dance for 3 times
         {
+            McpServer::GetInstance().ReportProgress(i - 1, 3, "Dancing round " + std::to_string(i));
             uint32_t head_mode = unbiasedRandom3(); // Randomly choose head mode 
             uint32_t hip_mode = unbiasedRandom3(); // Randomly choose hip mode
             movement_type(1, head_mode, 1); // Head forward
@@ -591,6 +592,9 @@ private:
         ESP_LOGI(TAG, "Head shake (on/off mode)!");
         
         for (int i = 0; i < 50; i++) {
+            if (i % 10 == 0) {
+                McpServer::GetInstance().ReportProgress(i, 50, "Shaking head");
+            }
             SetHeadSpeed(100);   // Full speed forward
             vTaskDelay(80 / portTICK_PERIOD_MS);
             
@@ -628,6 +632,9 @@ private:
         ESP_LOGI(TAG, "Hip shake (on/off mode)!");
         SetHeadSpeed(0);
         for (int i = 0; i < 12; i++) {
+            if (i % 3 == 0) {
+                McpServer::GetInstance().ReportProgress(i, 12, "Shaking hip");
+            }
             SetHipSpeed(100);    // Forward
             vTaskDelay(150 / portTICK_PERIOD_MS);
             SetHipSpeed(0);      // Stop - adds gentleness
@@ -140,8 +140,8 @@ private:
         power_save_timer_->OnEnterSleepMode([this]() {
             power_sleep_ = kDeviceNeutralSleep;
             XiaozhiStatus_ = kDevice_join_Sleep;
-            display_->SetChatMessage("system", "");
-            display_->SetEmotion("sleepy");
+            display_->PostChatMessage("system", "");
+            display_->PostEmotion("sleepy");
 
             if (LcdStatus_ != kDevicelcdbacklightOff) {
                 GetBacklight()->SetBrightness(1);
@@ -149,8 +149,8 @@ private:
         });
         power_save_timer_->OnExitSleepMode([this]() {
             power_sleep_ = kDeviceNoSleep;
-            display_->SetChatMessage("system", "");
-            display_->SetEmotion("neutral");
+            display_->PostChatMessage("system", "");
+            display_->PostEmotion("neutral");
 
             if (XiaozhiStatus_ != kDevice_Exit_Sleep) {
                 GetBacklight()->RestoreBrightness();
@@ -250,7 +250,7 @@ private:
                     GetBacklight()->SetBrightness(0);
                     LcdStatus_ = kDevicelcdbacklightOff;
                 } else if (LcdStatus_ == kDevicelcdbacklightOff && (power_status_ == kDeviceTypecSupply || power_status_ == kDeviceBatterySupply)) {
-                    GetDisplay()->SetChatMessage("system", "");
+                    GetDisplay()->PostChatMessage("system", "");
                     GetBacklight()->RestoreBrightness();
                     wake_status_ = kDeviceAwakened;
                     LcdStatus_ = kDevicelcdbacklightOn;
@@ -270,12 +270,12 @@ private:
                 volume = 0;
             }
             codec->SetOutputVolume(volume);
-            GetDisplay()->ShowNotification(Lang::Strings::VOLUME + std::to_string(volume));
+            GetDisplay()->PostNotification(Lang::Strings::VOLUME + std::to_string(volume));
         });
 
         left_button_.OnLongPress([this]() {
             GetAudioCodec()->SetOutputVolume(0);
-            GetDisplay()->ShowNotification(Lang::Strings::MUTED);
+            GetDisplay()->PostNotification(Lang::Strings::MUTED);
         });
 
         right_button_.OnClick([this]() {
@@ -289,12 +289,12 @@ private:
                 volume = 100;
             }
             codec->SetOutputVolume(volume);
-            GetDisplay()->ShowNotification(Lang::Strings::VOLUME + std::to_string(volume));
+            GetDisplay()->PostNotification(Lang::Strings::VOLUME + std::to_string(volume));
         });
 
         right_button_.OnLongPress([this]() {
             GetAudioCodec()->SetOutputVolume(100);
-            GetDisplay()->ShowNotification(Lang::Strings::MAX_VOLUME);
+            GetDisplay()->PostNotification(Lang::Strings::MAX_VOLUME);
         });
 
 
@@ -1,5 +1,6 @@
 #include "backlight.h"
 #include "settings.h"
+#include "iot/thing_manager.h"
 
 #include <esp_log.h>
 #include <driver/ledc.h>
@@ -78,6 +79,8 @@ void Backlight::OnTransitionTimer() {
 
     if (brightness_ == target_brightness_) {
         esp_timer_stop(transition_timer_);
+        // 渐变结束后上报最终亮度，旋钮、省电模式等修改也会立即上报
+        iot::ThingManager::GetInstance().NotifyPropertyChanged("Screen", "brightness");
     }
 }
 
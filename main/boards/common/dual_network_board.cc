@@ -46,10 +46,10 @@ void DualNetworkBoard::SwitchNetworkType() {
     auto display = GetDisplay();
     if (network_type_ == NetworkType::WIFI) {    
         SaveNetworkTypeToSettings(NetworkType::ML307);
-        display->ShowNotification(Lang::Strings::SWITCH_TO_4G_NETWORK);
+        display->PostNotification(Lang::Strings::SWITCH_TO_4G_NETWORK);
     } else {
         SaveNetworkTypeToSettings(NetworkType::WIFI);
-        display->ShowNotification(Lang::Strings::SWITCH_TO_WIFI_NETWORK);
+        display->PostNotification(Lang::Strings::SWITCH_TO_WIFI_NETWORK);
     }
     vTaskDelay(pdMS_TO_TICKS(1000));
     auto& app = Application::GetInstance();
@@ -65,9 +65,9 @@ void DualNetworkBoard::StartNetwork() {
     auto display = Board::GetInstance().GetDisplay();
     
     if (network_type_ == NetworkType::WIFI) {
-        display->SetStatus(Lang::Strings::CONNECTING);
+        display->PostStatus(Lang::Strings::CONNECTING);
     } else {
-        display->SetStatus(Lang::Strings::DETECTING_MODULE);
+        display->PostStatus(Lang::Strings::DETECTING_MODULE);
     }
     current_board_->StartNetwork();
 }
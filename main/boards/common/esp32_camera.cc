@@ -3,11 +3,13 @@
 #include "display.h"
 #include "board.h"
 #include "system_info.h"
+#include "image_ops.h"
 
 #include <esp_log.h>
 #include <esp_heap_caps.h>
 #include <img_converters.h>
 #include <cstring>
+#include <algorithm>
 
 #define TAG "Esp32Camera"
 
@@ -60,7 +62,7 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
 
     preview_image_.header.stride = preview_image_.header.w * 2;
     preview_image_.data_size = preview_image_.header.w * preview_image_.header.h * 2;
-    preview_image_.data = (uint8_t*)heap_caps_malloc(preview_image_.data_size, MALLOC_CAP_SPIRAM);
+    preview_image_.data = ImageOps::GetInstance().AllocBuffer(preview_image_.data_size);
     if (preview_image_.data == nullptr) {
         ESP_LOGE(TAG, "Failed to allocate memory for preview image");
         return;
@@ -115,14 +117,21 @@ bool Esp32Camera::Capture() {
     // 显示预览图片
     auto display = Board::GetInstance().GetDisplay();
     if (display != nullptr) {
-        auto src = (uint16_t*)fb_->buf;
-        auto dst = (uint16_t*)preview_image_.data;
-        size_t pixel_count = fb_->len / 2;
-        for (size_t i = 0; i < pixel_count; i++) {
+        auto& image_ops = ImageOps::GetInstance();
+        auto dst = (uint8_t*)preview_image_.data;
+        bool converted;
+        if (fb_->format == PIXFORMAT_JPEG) {
+            int width, height;
+            converted = image_ops.DecodeJpeg(fb_->buf, fb_->len, dst, preview_image_.data_size, &width, &height) &&
+                width == (int)preview_image_.header.w && height == (int)preview_image_.header.h;
+        } else {
             // 交换每个16位字内的字节
-            dst[i] = __builtin_bswap16(src[i]);
+            converted = image_ops.SwapBytes(fb_->buf, dst, preview_image_.header.w,
+                std::min<size_t>(fb_->len / 2 / preview_image_.header.w, preview_image_.header.h));
+        }
+        if (converted) {
+            display->SetPreviewImage(&preview_image_);
         }
-        display->SetPreviewImage(&preview_image_);
     }
     return true;
 }
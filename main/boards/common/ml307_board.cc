@@ -25,7 +25,7 @@ std::string Ml307Board::GetBoardType() {
 
 void Ml307Board::StartNetwork() {
     auto display = Board::GetInstance().GetDisplay();
-    display->SetStatus(Lang::Strings::DETECTING_MODULE);
+    display->PostStatus(Lang::Strings::DETECTING_MODULE);
     modem_.SetDebug(false);
     modem_.SetBaudRate(921600);
 
@@ -45,7 +45,7 @@ void Ml307Board::StartNetwork() {
 void Ml307Board::WaitForNetworkReady() {
     auto& application = Application::GetInstance();
     auto display = Board::GetInstance().GetDisplay();
-    display->SetStatus(Lang::Strings::REGISTERING_NETWORK);
+    display->PostStatus(Lang::Strings::REGISTERING_NETWORK);
     int result = modem_.WaitForNetworkReady();
     if (result == -1) {
         application.Alert(Lang::Strings::ERROR, Lang::Strings::PIN_ERROR, "sad", Lang::Sounds::P3_ERR_PIN);
@@ -136,7 +136,7 @@ private:
                 volume = 0;
             }
             codec->SetOutputVolume(volume);
-            self->GetDisplay()->ShowNotification(Lang::Strings::VOLUME + std::to_string(volume));
+            self->GetDisplay()->PostNotification(Lang::Strings::VOLUME + std::to_string(volume));
         }, this);
 
         // Button B
@@ -166,7 +166,7 @@ private:
                 volume = 100;
             }
             codec->SetOutputVolume(volume);
-            self->GetDisplay()->ShowNotification(Lang::Strings::VOLUME + std::to_string(volume));
+            self->GetDisplay()->PostNotification(Lang::Strings::VOLUME + std::to_string(volume));
         }, this);
     }
 
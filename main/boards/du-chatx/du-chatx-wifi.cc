@@ -49,13 +49,13 @@ private:
         power_save_timer_ = new PowerSaveTimer(-1, 60, 300);
         power_save_timer_->OnEnterSleepMode([this]() {
             ESP_LOGI(TAG, "Enabling sleep mode");
-            display_->SetChatMessage("system", "");
-            display_->SetEmotion("sleepy");
+            display_->PostChatMessage("system", "");
+            display_->PostEmotion("sleepy");
             GetBacklight()->SetBrightness(1); 
         });
         power_save_timer_->OnExitSleepMode([this]() {
-            display_->SetChatMessage("system", "");
-            display_->SetEmotion("neutral");
+            display_->PostChatMessage("system", "");
+            display_->PostEmotion("neutral");
             GetBacklight()->RestoreBrightness(); 
         });
         power_save_timer_->OnShutdownRequest([this]() {
@@ -16,7 +16,9 @@
 
 #define TAG "EspBox3Board"
 
+#if !CONFIG_USE_FONT_ASSETS
 LV_FONT_DECLARE(font_puhui_20_4);
+#endif
 LV_FONT_DECLARE(font_awesome_20_4);
 
 // Init ili9341 by custom cmd
@@ -133,7 +135,12 @@ private:
         display_ = new SpiLcdDisplay(panel_io, panel,
                                     DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_OFFSET_X, DISPLAY_OFFSET_Y, DISPLAY_MIRROR_X, DISPLAY_MIRROR_Y, DISPLAY_SWAP_XY,
                                     {
+#if CONFIG_USE_FONT_ASSETS
+                                        // 文本字体从 assets 分区加载，LVGL 默认字体只在加载失败时使用
+                                        .text_font = LV_FONT_DEFAULT,
+#else
                                         .text_font = &font_puhui_20_4,
+#endif
                                         .icon_font = &font_awesome_20_4,
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
                                         .emoji_font = font_emoji_32_init(),
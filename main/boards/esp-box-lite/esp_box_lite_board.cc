@@ -98,7 +98,7 @@ private:
             volume = 0;
         }
         codec->SetOutputVolume(volume);
-        GetDisplay()->ShowNotification(Lang::Strings::VOLUME + std::to_string(volume));
+        GetDisplay()->PostNotification(Lang::Strings::VOLUME + std::to_string(volume));
     }
     
     void TogleState() {
@@ -140,14 +140,14 @@ private:
         volume_up_button->OnClick([this]() {ChangeVol(10);});
         volume_up_button->OnLongPress([this]() {
             GetAudioCodec()->SetOutputVolume(100);
-            GetDisplay()->ShowNotification(Lang::Strings::MAX_VOLUME);
+            GetDisplay()->PostNotification(Lang::Strings::MAX_VOLUME);
         });
 
         auto volume_down_button = adc_button_[BSP_ADC_BUTTON_PREV];
         volume_down_button->OnClick([this]() {ChangeVol(-10);});
         volume_down_button->OnLongPress([this]() {
             GetAudioCodec()->SetOutputVolume(0);
-            GetDisplay()->ShowNotification(Lang::Strings::MUTED);
+            GetDisplay()->PostNotification(Lang::Strings::MUTED);
         });
 
         auto break_button = adc_button_[BSP_ADC_BUTTON_ENTER];
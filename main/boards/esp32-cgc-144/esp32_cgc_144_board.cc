@@ -71,13 +71,13 @@ void InitializePowerManager() {
         power_save_timer_ = new PowerSaveTimer(-1, 60);
         power_save_timer_->OnEnterSleepMode([this]() {
             ESP_LOGI(TAG, "Enabling sleep mode");
-            display_->SetChatMessage("system", "");
-            display_->SetEmotion("sleepy");
+            display_->PostChatMessage("system", "");
+            display_->PostEmotion("sleepy");
             GetBacklight()->SetBrightness(1);
         });
         power_save_timer_->OnExitSleepMode([this]() {
-            display_->SetChatMessage("system", "");
-            display_->SetEmotion("neutral");
+            display_->PostChatMessage("system", "");
+            display_->PostEmotion("neutral");
             GetBacklight()->RestoreBrightness();
         });
 
@@ -67,14 +67,14 @@ private:
         power_save_timer_->OnEnterSleepMode([this]() {
             ESP_LOGI(TAG, "Enabling sleep mode");
             auto display = GetDisplay();
-            display->SetChatMessage("system", "");
-            display->SetEmotion("sleepy");
+            display->PostChatMessage("system", "");
+            display->PostEmotion("sleepy");
             GetBacklight()->SetBrightness(10);
         });
         power_save_timer_->OnExitSleepMode([this]() {
             auto display = GetDisplay();
-            display->SetChatMessage("system", "");
-            display->SetEmotion("neutral");
+            display->PostChatMessage("system", "");
+            display->PostEmotion("neutral");
             GetBacklight()->RestoreBrightness();
         });
         power_save_timer_->SetEnabled(true);
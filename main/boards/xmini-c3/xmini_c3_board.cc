@@ -37,8 +37,8 @@ private:
         power_save_timer_->OnEnterSleepMode([this]() {
             ESP_LOGI(TAG, "Enabling sleep mode");
             auto display = GetDisplay();
-            display->SetChatMessage("system", "");
-            display->SetEmotion("sleepy");
+            display->PostChatMessage("system", "");
+            display->PostEmotion("sleepy");
             
             auto codec = GetAudioCodec();
             codec->EnableInput(false);
@@ -48,8 +48,8 @@ private:
             codec->EnableInput(true);
             
             auto display = GetDisplay();
-            display->SetChatMessage("system", "");
-            display->SetEmotion("neutral");
+            display->PostChatMessage("system", "");
+            display->PostEmotion("neutral");
         });
         power_save_timer_->SetEnabled(true);
     }
@@ -0,0 +1,365 @@
+#include "asset_font.h"
+#include "mmap_generate_fonts.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "AssetFont"
+
+#define ASSET_FONT_PARTITION "assets_A"
+// 缓存的字符数，必须是 2 的幂
+#define ASSET_FONT_CACHE_SLOTS_SPIRAM 512
+#define ASSET_FONT_CACHE_SLOTS_INTERNAL 64
+#define ASSET_FONT_LOG_INTERVAL 100
+
+// lv_font_conv bin format, see lv_binfont_loader.c
+#define FONT_HEAD_SIZE 40
+#define FONT_CMAP_SUBTABLE_SIZE 16
+
+static uint32_t ReadU32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint16_t ReadU16(const uint8_t* p) {
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Glyph headers and bitmaps are packed MSB first without byte alignment
+class BitReader {
+public:
+    BitReader(const uint8_t* data) : data_(data) {}
+
+    uint32_t Read(int bits) {
+        uint32_t value = 0;
+        for (int i = 0; i < bits; i++) {
+            value = (value << 1) | ((data_[bit_pos_ >> 3] >> (7 - (bit_pos_ & 7))) & 1);
+            bit_pos_++;
+        }
+        return value;
+    }
+
+    int32_t ReadSigned(int bits) {
+        uint32_t value = Read(bits);
+        if (bits > 0 && (value & (1u << (bits - 1)))) {
+            value |= ~0u << bits;
+        }
+        return (int32_t)value;
+    }
+
+    void ReadBytes(uint8_t* out, size_t size) {
+        if ((bit_pos_ & 7) == 0) {
+            memcpy(out, data_ + (bit_pos_ >> 3), size);
+            bit_pos_ += size * 8;
+            return;
+        }
+        for (size_t i = 0; i < size; i++) {
+            out[i] = Read(8);
+        }
+    }
+
+private:
+    const uint8_t* data_;
+    uint32_t bit_pos_ = 0;
+};
+
+AssetFont::AssetFont(const char* file_name) {
+    const mmap_assets_config_t assets_cfg = {
+        .partition_label = ASSET_FONT_PARTITION,
+        .max_files = MMAP_FONTS_FILES,
+        .checksum = MMAP_FONTS_CHECKSUM,
+        .flags = {.mmap_enable = true, .full_check = true}
+    };
+    if (mmap_assets_new(&assets_cfg, &assets_) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map the %s partition", ASSET_FONT_PARTITION);
+        assets_ = nullptr;
+        return;
+    }
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    for (int i = 0; i < mmap_assets_get_stored_files(assets_); i++) {
+        if (strcmp(mmap_assets_get_name(assets_, i), file_name) == 0) {
+            data = mmap_assets_get_mem(assets_, i);
+            size = mmap_assets_get_size(assets_, i);
+            break;
+        }
+    }
+    if (data == nullptr) {
+        ESP_LOGE(TAG, "Font %s not found in the %s partition", file_name, ASSET_FONT_PARTITION);
+        return;
+    }
+    if (!Parse(data, size)) {
+        ESP_LOGE(TAG, "Invalid font file %s", file_name);
+        return;
+    }
+
+    uint32_t slots = ASSET_FONT_CACHE_SLOTS_SPIRAM;
+    uint32_t caps = MALLOC_CAP_SPIRAM;
+    if (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) == 0) {
+        slots = ASSET_FONT_CACHE_SLOTS_INTERNAL;
+        caps = MALLOC_CAP_8BIT;
+    }
+    // LVGL treats glyph id 0 as no glyph, slot 0 is reserved and the cache uses slots 1 to slots
+    slot_letters_ = (uint32_t*)heap_caps_calloc(slots + 1, sizeof(uint32_t), caps);
+    slot_glyph_dsc_ = (lv_font_fmt_txt_glyph_dsc_t*)heap_caps_calloc(slots + 1, sizeof(lv_font_fmt_txt_glyph_dsc_t), caps);
+    slot_bitmaps_ = (uint8_t*)heap_caps_malloc((slots + 1) * slot_bitmap_size_, caps);
+    if (slot_letters_ == nullptr || slot_glyph_dsc_ == nullptr || slot_bitmaps_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate the glyph cache");
+        return;
+    }
+    slot_mask_ = slots - 1;
+
+    // The bitmap of a cached glyph is read by the LVGL fmt_txt renderer, the glyph id is the cache slot
+    dsc_.glyph_bitmap = slot_bitmaps_;
+    dsc_.glyph_dsc = slot_glyph_dsc_;
+    dsc_.cmaps = cmaps_.data();
+    dsc_.cmap_num = cmaps_.size();
+    dsc_.bpp = bpp_;
+    dsc_.bitmap_format = LV_FONT_FMT_TXT_PLAIN;
+
+    font_.get_glyph_dsc = GetGlyphDsc;
+    font_.get_glyph_bitmap = lv_font_get_bitmap_fmt_txt;
+    font_.subpx = LV_FONT_SUBPX_NONE;
+    font_.kerning = LV_FONT_KERNING_NONE;
+    font_.dsc = &dsc_;
+    font_.user_data = this;
+    loaded_ = true;
+
+    ESP_LOGI(TAG, "Loaded font %s: %u glyphs, %u bytes in flash, line height %d, cache %u glyphs (%u bytes)", file_name,
+        (unsigned)glyph_count_, (unsigned)size, (int)font_.line_height, (unsigned)slots,
+        (unsigned)((slots + 1) * (slot_bitmap_size_ + sizeof(uint32_t) + sizeof(lv_font_fmt_txt_glyph_dsc_t))));
+}
+
+AssetFont::~AssetFont() {
+    heap_caps_free(slot_letters_);
+    heap_caps_free(slot_glyph_dsc_);
+    heap_caps_free(slot_bitmaps_);
+    if (assets_ != nullptr) {
+        mmap_assets_del(assets_);
+    }
+}
+
+bool AssetFont::Parse(const uint8_t* data, size_t size) {
+    // Each table starts with its length (including this header) and a 4 character label
+    size_t offset = 0;
+    auto next_table = [&](const char* label, const uint8_t*& table, uint32_t& length) -> bool {
+        if (offset + 8 > size) {
+            return false;
+        }
+        length = ReadU32(data + offset);
+        if (length < 8 || offset + length > size || memcmp(data + offset + 4, label, 4) != 0) {
+            ESP_LOGE(TAG, "Missing table %s", label);
+            return false;
+        }
+        table = data + offset;
+        offset += length;
+        return true;
+    };
+
+    const uint8_t* head;
+    uint32_t head_length;
+    if (!next_table("head", head, head_length) || head_length < 8 + FONT_HEAD_SIZE) {
+        return false;
+    }
+    head += 8;
+    int16_t ascent = (int16_t)ReadU16(head + 8);
+    int16_t descent = (int16_t)ReadU16(head + 10);
+    int16_t min_y = (int16_t)ReadU16(head + 18);
+    int16_t max_y = (int16_t)ReadU16(head + 20);
+    default_advance_width_ = ReadU16(head + 22);
+    loca_32bit_ = head[26] != 0;
+    advance_width_fixed_point_ = head[28] != 0;
+    bpp_ = head[29];
+    xy_bits_ = head[30];
+    wh_bits_ = head[31];
+    advance_width_bits_ = head[32];
+    if (head[33] != 0) {
+        ESP_LOGE(TAG, "Compressed fonts are not supported");
+        return false;
+    }
+    font_.line_height = ascent - descent;
+    font_.base_line = -descent;
+    font_.underline_position = (int16_t)ReadU16(head + 36);
+    font_.underline_thickness = ReadU16(head + 38);
+
+    const uint8_t* cmap;
+    uint32_t cmap_length;
+    if (!next_table("cmap", cmap, cmap_length)) {
+        return false;
+    }
+    uint32_t cmap_count = ReadU32(cmap + 8);
+    if (12 + cmap_count * FONT_CMAP_SUBTABLE_SIZE > cmap_length) {
+        return false;
+    }
+    cmaps_.resize(cmap_count);
+    for (uint32_t i = 0; i < cmap_count; i++) {
+        const uint8_t* subtable = cmap + 12 + i * FONT_CMAP_SUBTABLE_SIZE;
+        auto& entry = cmaps_[i];
+        const uint8_t* list = cmap + ReadU32(subtable);
+        entry.range_start = ReadU32(subtable + 4);
+        entry.range_length = ReadU16(subtable + 8);
+        entry.glyph_id_start = ReadU16(subtable + 10);
+        entry.list_length = ReadU16(subtable + 12);
+        entry.type = (lv_font_fmt_txt_cmap_type_t)subtable[14];
+        entry.unicode_list = nullptr;
+        entry.glyph_id_ofs_list = nullptr;
+        if (entry.type == LV_FONT_FMT_TXT_CMAP_FORMAT0_FULL) {
+            entry.glyph_id_ofs_list = list;
+        } else if (entry.type == LV_FONT_FMT_TXT_CMAP_SPARSE_FULL || entry.type == LV_FONT_FMT_TXT_CMAP_SPARSE_TINY) {
+            // The lists are read in place from flash as uint16_t arrays
+            if (((uintptr_t)list & 1) != 0) {
+                ESP_LOGE(TAG, "Unaligned cmap list");
+                return false;
+            }
+            entry.unicode_list = (const uint16_t*)list;
+            if (entry.type == LV_FONT_FMT_TXT_CMAP_SPARSE_FULL) {
+                entry.glyph_id_ofs_list = list + entry.list_length * sizeof(uint16_t);
+            }
+        }
+    }
+
+    const uint8_t* loca;
+    uint32_t loca_length;
+    if (!next_table("loca", loca, loca_length)) {
+        return false;
+    }
+    glyph_count_ = ReadU32(loca + 8);
+    loca_ = loca + 12;
+    if (12 + glyph_count_ * (loca_32bit_ ? 4 : 2) > loca_length) {
+        return false;
+    }
+
+    if (!next_table("glyf", glyf_, glyf_size_)) {
+        return false;
+    }
+
+    // 缓存位置按字体头的包围盒上限分配，启动时不遍历字形（中文字库有上万个字形）
+    uint32_t max_box_w = (1u << wh_bits_) - 1;
+    uint32_t max_box_h = max_box_w;
+    if (max_y > min_y) {
+        max_box_h = std::min<uint32_t>(max_box_h, max_y - min_y);
+    }
+    slot_bitmap_size_ = (max_box_w * max_box_h * bpp_ + 7) / 8;
+    return true;
+}
+
+uint32_t AssetFont::GlyphOffset(uint32_t glyph_id) const {
+    return loca_32bit_ ? ReadU32(loca_ + glyph_id * 4) : ReadU16(loca_ + glyph_id * 2);
+}
+
+uint32_t AssetFont::GlyphBitmapSize(uint32_t glyph_id) const {
+    BitReader reader(glyf_ + GlyphOffset(glyph_id));
+    reader.Read(advance_width_bits_ + 2 * xy_bits_);
+    uint32_t box_w = reader.Read(wh_bits_);
+    uint32_t box_h = reader.Read(wh_bits_);
+    return (box_w * box_h * bpp_ + 7) / 8;
+}
+
+// Same lookup as the fmt_txt fonts, over the cmap lists in flash
+uint32_t AssetFont::FindGlyphId(uint32_t letter) const {
+    for (const auto& cmap : cmaps_) {
+        uint32_t rcp = letter - cmap.range_start;
+        if (rcp >= cmap.range_length) {
+            continue;
+        }
+        switch (cmap.type) {
+        case LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY:
+            return cmap.glyph_id_start + rcp;
+        case LV_FONT_FMT_TXT_CMAP_FORMAT0_FULL:
+            return cmap.glyph_id_start + static_cast<const uint8_t*>(cmap.glyph_id_ofs_list)[rcp];
+        default: {
+            auto end = cmap.unicode_list + cmap.list_length;
+            auto it = std::lower_bound(cmap.unicode_list, end, (uint16_t)rcp);
+            if (it == end || *it != rcp) {
+                continue;
+            }
+            uint32_t index = it - cmap.unicode_list;
+            if (cmap.type == LV_FONT_FMT_TXT_CMAP_SPARSE_TINY) {
+                return cmap.glyph_id_start + index;
+            }
+            return cmap.glyph_id_start + static_cast<const uint16_t*>(cmap.glyph_id_ofs_list)[index];
+        }
+        }
+    }
+    return 0;
+}
+
+void AssetFont::DecodeGlyph(uint32_t glyph_id, lv_font_fmt_txt_glyph_dsc_t& glyph_dsc, uint8_t* bitmap) const {
+    BitReader reader(glyf_ + GlyphOffset(glyph_id));
+    uint32_t adv_w = advance_width_bits_ > 0 ? reader.Read(advance_width_bits_) : default_advance_width_;
+    if (!advance_width_fixed_point_) {
+        adv_w *= 16;
+    }
+    glyph_dsc.adv_w = adv_w;
+    glyph_dsc.ofs_x = reader.ReadSigned(xy_bits_);
+    glyph_dsc.ofs_y = reader.ReadSigned(xy_bits_);
+    glyph_dsc.box_w = reader.Read(wh_bits_);
+    glyph_dsc.box_h = reader.Read(wh_bits_);
+    reader.ReadBytes(bitmap, (glyph_dsc.box_w * glyph_dsc.box_h * bpp_ + 7) / 8);
+}
+
+// Returns the cache slot of the letter (never 0), -1 if the font has no such glyph
+int AssetFont::LoadGlyph(uint32_t letter) {
+    uint32_t slot = (letter & slot_mask_) + 1;
+    if (slot_letters_[slot] == letter) {
+        return slot;
+    }
+    uint32_t glyph_id = FindGlyphId(letter);
+    if (glyph_id == 0 || glyph_id >= glyph_count_) {
+        return -1;
+    }
+
+    if (GlyphBitmapSize(glyph_id) > slot_bitmap_size_) {
+        ESP_LOGW(TAG, "Glyph of U+%04X exceeds the font bounding box", (unsigned)letter);
+        return -1;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    auto& glyph_dsc = slot_glyph_dsc_[slot];
+    glyph_dsc.bitmap_index = slot * slot_bitmap_size_;
+    DecodeGlyph(glyph_id, glyph_dsc, slot_bitmaps_ + glyph_dsc.bitmap_index);
+    slot_letters_[slot] = letter;
+
+    glyph_load_us_ += esp_timer_get_time() - start_time;
+    if (++glyphs_loaded_ % ASSET_FONT_LOG_INTERVAL == 0) {
+        ESP_LOGI(TAG, "Loaded %u glyphs from flash, avg %d us per glyph", (unsigned)glyphs_loaded_,
+            (int)(glyph_load_us_ / glyphs_loaded_));
+    }
+    return slot;
+}
+
+bool AssetFont::GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    auto self = static_cast<AssetFont*>(font->user_data);
+    // Like fmt_txt fonts, a tab is two spaces wide
+    bool is_tab = letter == '\t';
+    if (is_tab) {
+        letter = ' ';
+    }
+    if (letter == 0) {
+        return false;
+    }
+    int slot = self->LoadGlyph(letter);
+    if (slot < 0) {
+        return false;
+    }
+
+    const auto& glyph_dsc = self->slot_glyph_dsc_[slot];
+    uint32_t adv_w = is_tab ? glyph_dsc.adv_w * 2 : glyph_dsc.adv_w;
+    dsc->adv_w = (adv_w + (1 << 3)) >> 4;
+    dsc->box_w = is_tab ? glyph_dsc.box_w * 2 : glyph_dsc.box_w;
+    dsc->box_h = glyph_dsc.box_h;
+    dsc->ofs_x = glyph_dsc.ofs_x;
+    dsc->ofs_y = glyph_dsc.ofs_y;
+    dsc->format = (lv_font_glyph_format_t)self->bpp_;
+    dsc->is_placeholder = false;
+    // lv_font_get_bitmap_fmt_txt looks up the glyph descriptor by this index
+    dsc->gid.index = slot;
+    return true;
+}
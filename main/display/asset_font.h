@@ -0,0 +1,67 @@
+#ifndef ASSET_FONT_H
+#define ASSET_FONT_H
+
+#include <lvgl.h>
+#include <esp_mmap_assets.h>
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * 从 assets 分区加载的字体
+ *
+ * 字体文件是 lv_font_conv 生成的 bin 格式（不压缩），通过 mmap 直接访问，不复制到内存。
+ * 字符第一次使用时才解码它的 glyph 描述和位图，放入一个固定大小的内存缓存，
+ * 缓存满时替换同一位置的旧字符。这样中文字库不需要编译进应用固件。
+ */
+class AssetFont {
+public:
+    explicit AssetFont(const char* file_name);
+    ~AssetFont();
+    AssetFont(const AssetFont&) = delete;
+    AssetFont& operator=(const AssetFont&) = delete;
+
+    // nullptr if the font could not be loaded
+    const lv_font_t* font() const { return loaded_ ? &font_ : nullptr; }
+
+private:
+    bool Parse(const uint8_t* data, size_t size);
+    uint32_t GlyphOffset(uint32_t glyph_id) const;
+    uint32_t GlyphBitmapSize(uint32_t glyph_id) const;
+    uint32_t FindGlyphId(uint32_t letter) const;
+    void DecodeGlyph(uint32_t glyph_id, lv_font_fmt_txt_glyph_dsc_t& glyph_dsc, uint8_t* bitmap) const;
+    int LoadGlyph(uint32_t letter);
+
+    static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+
+    mmap_assets_handle_t assets_ = nullptr;
+    bool loaded_ = false;
+    lv_font_t font_ = {};
+    lv_font_fmt_txt_dsc_t dsc_ = {};
+    std::vector<lv_font_fmt_txt_cmap_t> cmaps_;
+
+    // Font tables in flash
+    const uint8_t* glyf_ = nullptr;
+    uint32_t glyf_size_ = 0;
+    const uint8_t* loca_ = nullptr;
+    bool loca_32bit_ = false;
+    uint32_t glyph_count_ = 0;
+    uint8_t bpp_ = 0;
+    uint8_t xy_bits_ = 0;
+    uint8_t wh_bits_ = 0;
+    uint8_t advance_width_bits_ = 0;
+    bool advance_width_fixed_point_ = false;
+    uint16_t default_advance_width_ = 0;
+
+    // Glyph cache, a slot holds the descriptor and the bitmap of one letter
+    uint32_t* slot_letters_ = nullptr;
+    lv_font_fmt_txt_glyph_dsc_t* slot_glyph_dsc_ = nullptr;
+    uint8_t* slot_bitmaps_ = nullptr;
+    uint32_t slot_mask_ = 0;
+    uint32_t slot_bitmap_size_ = 0;
+
+    uint32_t glyphs_loaded_ = 0;
+    int64_t glyph_load_us_ = 0;
+};
+
+#endif // ASSET_FONT_H
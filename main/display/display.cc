@@ -1,5 +1,6 @@
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_heap_caps.h>
 #include <string>
 #include <cstdlib>
 #include <cstring>
@@ -11,6 +12,9 @@
 #include "audio_codec.h"
 #include "settings.h"
 #include "assets/lang_config.h"
+#include "image_ops.h"
+
+#include <img_converters.h>
 
 #define TAG "Display"
 
@@ -40,6 +44,9 @@ Display::Display() {
 }
 
 Display::~Display() {
+    if (command_timer_ != nullptr) {
+        lv_timer_delete(command_timer_);
+    }
     if (notification_timer_ != nullptr) {
         esp_timer_stop(notification_timer_);
         esp_timer_delete(notification_timer_);
@@ -66,7 +73,10 @@ void Display::SetStatus(const char* status) {
     if (status_label_ == nullptr) {
         return;
     }
-    lv_label_set_text(status_label_, status);
+    // 文本相同时不重新设置，避免状态栏重绘
+    if (strcmp(lv_label_get_text(status_label_), status) != 0) {
+        lv_label_set_text(status_label_, status);
+    }
     lv_obj_clear_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
 }
@@ -88,25 +98,212 @@ void Display::ShowNotification(const char* notification, int duration_ms) {
     ESP_ERROR_CHECK(esp_timer_start_once(notification_timer_, duration_ms * 1000));
 }
 
-void Display::UpdateStatusBar(bool update_all) {
-    auto& board = Board::GetInstance();
-    auto codec = board.GetAudioCodec();
+bool Display::StartCommandTimer() {
+    // 没有 LVGL 显示的实现（NoDisplay 等）直接同步调用
+    if (display_ == nullptr) {
+        return false;
+    }
+    if (!command_timer_started_.exchange(true)) {
+        DisplayLockGuard lock(this);
+        command_timer_ = lv_timer_create([](lv_timer_t* timer) {
+            auto display = static_cast<Display*>(lv_timer_get_user_data(timer));
+            display->RunCommands();
+        }, LV_DEF_REFR_PERIOD, this);
+    }
+    return true;
+}
 
+// Runs with the display locked, either in the LVGL task or in a producer that found the chat queue full
+void Display::RunCommands() {
+    auto status = pending_status_.Take();
+    auto notification = pending_notification_.Take();
+    if (status && notification && notification->sequence < status->sequence) {
+        ShowNotification(notification->text.c_str(), notification->duration_ms);
+        notification.reset();
+    }
+    if (status) {
+        SetStatus(status->text.c_str());
+    }
+    if (notification) {
+        ShowNotification(notification->text.c_str(), notification->duration_ms);
+    }
+
+    int refresh_period = pending_refresh_period_.exchange(0);
+    if (refresh_period > 0 && refresh_period != refresh_period_ms_) {
+        refresh_period_ms_ = refresh_period;
+        lv_timer_set_period(lv_display_get_refr_timer(display_), refresh_period);
+        lv_timer_set_period(command_timer_, refresh_period);
+    }
+
+    auto emotion = pending_emotion_.Take();
+    if (emotion) {
+        SetEmotion(emotion->c_str());
+    }
+
+    ChatCommand chat;
+    ChatCommand next;
+    bool has_chat = pending_chat_messages_.Pop(chat);
+    while (has_chat) {
+        bool has_next = pending_chat_messages_.Pop(next);
+        // 连续的系统消息只显示最后一条
+        if (has_next && chat.role == "system" && next.role == "system") {
+            commands_coalesced_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            SetChatMessage(chat.role.c_str(), chat.content.c_str());
+        }
+        chat = std::move(next);
+        has_chat = has_next;
+    }
+}
+
+void Display::SetRefreshPeriod(int period_ms) {
+    if (StartCommandTimer()) {
+        pending_refresh_period_.store(period_ms);
+    }
+}
+
+std::string Display::GetPerfStatsJson() {
+    // LVGL 使用 C 库的 malloc，内存占用体现在系统堆上
+    uint32_t lock_count = lock_count_.load();
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "{\"refresh_period_ms\":%d,\"display_lock\":{\"count\":%u,\"wait_avg_us\":%u,"
+        "\"wait_max_us\":%u},\"heap\":{\"free_internal\":%u,\"min_free_internal\":%u,\"free_spiram\":%u}}",
+        refresh_period_ms_, (unsigned)lock_count, (unsigned)(lock_count > 0 ? lock_wait_us_.load() / lock_count : 0),
+        (unsigned)lock_wait_max_us_.load(), (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+        (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL), (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    return buffer;
+}
+
+bool Display::CaptureJpeg(std::string& jpeg, int quality, int* width, int* height) {
+#if LV_USE_SNAPSHOT
+    if (display_ == nullptr) {
+        return false;
+    }
+    int64_t start_time = esp_timer_get_time();
+    lv_draw_buf_t* snapshot = nullptr;
     {
         DisplayLockGuard lock(this);
-        if (mute_label_ == nullptr) {
-            return;
+        lv_obj_t* screen = lv_display_get_screen_active(display_);
+        // 截图需要一整屏的 RGB565 缓冲区，内存不足时直接放弃，避免挤占音频等其他任务的内存
+        size_t buffer_size = lv_obj_get_width(screen) * lv_obj_get_height(screen) * 2;
+        size_t largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+        if (buffer_size > largest_block / 2) {
+            ESP_LOGW(TAG, "Not enough memory for a screenshot: need %u bytes, largest free block %u bytes",
+                (unsigned)buffer_size, (unsigned)largest_block);
+            return false;
         }
+        snapshot = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
+    }
+    if (snapshot == nullptr) {
+        ESP_LOGE(TAG, "Failed to take screenshot");
+        return false;
+    }
+    int64_t capture_time = esp_timer_get_time() - start_time;
 
-        // 如果静音状态改变，则更新图标
-        if (codec->output_volume() == 0 && !muted_) {
-            muted_ = true;
-            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_MUTE);
-        } else if (codec->output_volume() > 0 && muted_) {
-            muted_ = false;
-            lv_label_set_text(mute_label_, "");
+    int w = snapshot->header.w;
+    int h = snapshot->header.h;
+    uint8_t* pixels = snapshot->data;
+    if (snapshot->header.stride != w * 2) {
+        // 去掉行尾的对齐填充
+        for (int y = 1; y < h; y++) {
+            memmove(pixels + y * w * 2, pixels + y * snapshot->header.stride, w * 2);
         }
     }
+    // The encoder takes big-endian RGB565, the same as the camera frames
+    ImageOps::GetInstance().SwapBytes(pixels, pixels, w, h);
+
+    jpeg.clear();
+    bool success = fmt2jpg_cb(pixels, w * h * 2, w, h, PIXFORMAT_RGB565, quality,
+        [](void* arg, size_t index, const void* data, size_t len) -> size_t {
+            auto output = static_cast<std::string*>(arg);
+            output->append(static_cast<const char*>(data), len);
+            return len;
+        }, &jpeg);
+    lv_draw_buf_destroy(snapshot);
+    if (!success) {
+        ESP_LOGE(TAG, "Failed to encode screenshot");
+        jpeg.clear();
+        return false;
+    }
+    *width = w;
+    *height = h;
+    ESP_LOGI(TAG, "Screenshot %dx%d, %u bytes, capture %d ms, encode %d ms, remain stack size %u", w, h,
+        (unsigned)jpeg.size(), (int)(capture_time / 1000), (int)((esp_timer_get_time() - start_time - capture_time) / 1000),
+        (unsigned)uxTaskGetStackHighWaterMark(nullptr));
+    return true;
+#else
+    ESP_LOGW(TAG, "Screenshot needs CONFIG_LV_USE_SNAPSHOT");
+    return false;
+#endif
+}
+
+void Display::PostStatus(const char* status) {
+    if (!StartCommandTimer()) {
+        SetStatus(status);
+        return;
+    }
+    auto command = std::make_unique<TextCommand>(TextCommand{status, 0, command_sequence_.fetch_add(1)});
+    if (pending_status_.Put(std::move(command))) {
+        commands_coalesced_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Display::PostEmotion(const char* emotion) {
+    if (!StartCommandTimer()) {
+        SetEmotion(emotion);
+        return;
+    }
+    if (pending_emotion_.Put(std::make_unique<std::string>(emotion))) {
+        commands_coalesced_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Display::PostNotification(const std::string& notification, int duration_ms) {
+    PostNotification(notification.c_str(), duration_ms);
+}
+
+void Display::PostNotification(const char* notification, int duration_ms) {
+    if (!StartCommandTimer()) {
+        ShowNotification(notification, duration_ms);
+        return;
+    }
+    auto command = std::make_unique<TextCommand>(TextCommand{notification, duration_ms, command_sequence_.fetch_add(1)});
+    if (pending_notification_.Put(std::move(command))) {
+        commands_coalesced_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Display::PostChatMessage(const char* role, const char* content) {
+    if (!StartCommandTimer()) {
+        SetChatMessage(role, content);
+        return;
+    }
+    if (!pending_chat_messages_.Push(ChatCommand{role, content})) {
+        // 队列已满，持有显示锁时 LVGL 任务不会同时处理队列，先处理积压的消息再直接显示
+        ESP_LOGW(TAG, "Display command queue is full");
+        DisplayLockGuard lock(this);
+        RunCommands();
+        SetChatMessage(role, content);
+    }
+}
+
+void Display::UpdateStatusBar(bool update_all) {
+    // 状态栏在 SetupUI 中创建，之后不会改变
+    if (mute_label_ == nullptr) {
+        return;
+    }
+
+    auto& board = Board::GetInstance();
+    auto codec = board.GetAudioCodec();
+
+    // 先在锁外读取状态，只有图标变化时才锁定显示并刷新对应的标签
+    bool muted = codec->output_volume() == 0;
+    if (muted != muted_ || update_all) {
+        DisplayLockGuard lock(this);
+        muted_ = muted;
+        lv_label_set_text(mute_label_, muted_ ? FONT_AWESOME_VOLUME_MUTE : "");
+        status_bar_updates_++;
+    }
 
     esp_pm_lock_acquire(pm_lock_);
     // 更新电池图标
@@ -127,31 +324,37 @@ void Display::UpdateStatusBar(bool update_all) {
             };
             icon = levels[battery_level / 20];
         }
-        DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon) {
-            battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
-        }
-
-        if (low_battery_popup_ != nullptr) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框隐藏，则显示
-                    lv_obj_clear_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    auto& app = Application::GetInstance();
-                    app.PlaySound(Lang::Sounds::P3_LOW_BATTERY);
+        bool low_battery = strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging;
+        if (battery_icon_ != icon || low_battery != low_battery_shown_) {
+            DisplayLockGuard lock(this);
+            // 缓存的状态总是更新，没有电池标签或低电量弹窗的布局也不会每秒都锁定显示
+            if (battery_icon_ != icon) {
+                battery_icon_ = icon;
+                if (battery_label_ != nullptr) {
+                    lv_label_set_text(battery_label_, battery_icon_);
                 }
-            } else {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框显示，则隐藏
-                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+            }
+
+            if (low_battery != low_battery_shown_) {
+                low_battery_shown_ = low_battery;
+                if (low_battery_popup_ != nullptr) {
+                    if (low_battery) {
+                        lv_obj_clear_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+                        auto& app = Application::GetInstance();
+                        app.PlaySound(Lang::Sounds::P3_LOW_BATTERY);
+                    } else {
+                        // Hide the low battery popup when the battery is not empty
+                        lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+                    }
                 }
             }
+            status_bar_updates_++;
         }
     }
 
     // 每 10 秒更新一次网络图标
     static int seconds_counter = 0;
-    if (update_all || seconds_counter++ % 10 == 0) {
+    if (update_all || seconds_counter % 10 == 0) {
         // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
         auto device_state = Application::GetInstance().GetDeviceState();
         static const std::vector<DeviceState> allowed_states = {
@@ -167,10 +370,20 @@ void Display::UpdateStatusBar(bool update_all) {
                 DisplayLockGuard lock(this);
                 network_icon_ = icon;
                 lv_label_set_text(network_label_, network_icon_);
+                status_bar_updates_++;
             }
         }
     }
 
+    if (++seconds_counter % 60 == 0) {
+        uint32_t lock_count = lock_count_.exchange(0);
+        uint32_t lock_wait_us = lock_wait_us_.exchange(0);
+        ESP_LOGI(TAG, "Last minute: %d status bar updates, %u display locks, wait avg %u us max %u us, %u commands coalesced",
+            status_bar_updates_, (unsigned)lock_count, (unsigned)(lock_count > 0 ? lock_wait_us / lock_count : 0),
+            (unsigned)lock_wait_max_us_.exchange(0), (unsigned)commands_coalesced_.exchange(0));
+        status_bar_updates_ = 0;
+    }
+
     esp_pm_lock_release(pm_lock_);
 }
 
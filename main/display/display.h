@@ -7,6 +7,9 @@
 #include <esp_pm.h>
 
 #include <string>
+#include <atomic>
+
+#include "display_command_queue.h"
 
 struct DisplayFonts {
     const lv_font_t* text_font = nullptr;
@@ -29,9 +32,26 @@ public:
     virtual void SetTheme(const std::string& theme_name);
     virtual std::string GetTheme() { return current_theme_name_; }
     virtual void UpdateStatusBar(bool update_all = false);
+    // 调整 LVGL 刷新周期，在 LVGL 任务的下一帧生效
+    virtual void SetRefreshPeriod(int period_ms);
+    // 性能统计：JSON 快照和屏幕上的性能浮层
+    virtual std::string GetPerfStatsJson();
+    virtual void SetPerfHudVisible(bool visible) {}
+    // 截取当前屏幕并编码为 JPEG，只在渲染时持有显示锁，编码在调用者的任务中进行
+    virtual bool CaptureJpeg(std::string& jpeg, int quality, int* width, int* height);
+
+    // 投递到 LVGL 任务，在下一帧统一执行，调用者不需要等待显示锁
+    // 未处理的状态、表情和通知只保留最新的一条，聊天消息按顺序保留
+    void PostStatus(const char* status);
+    void PostEmotion(const char* emotion);
+    void PostChatMessage(const char* role, const char* content);
+    void PostNotification(const char* notification, int duration_ms = 3000);
+    void PostNotification(const std::string& notification, int duration_ms = 3000);
 
     inline int width() const { return width_; }
     inline int height() const { return height_; }
+    // NoDisplay 没有 LVGL 显示，依赖屏幕内容的功能（性能统计、截图）不可用
+    inline bool has_lvgl_display() const { return display_ != nullptr; }
 
 protected:
     int width_ = 0;
@@ -53,10 +73,47 @@ protected:
     const char* battery_icon_ = nullptr;
     const char* network_icon_ = nullptr;
     bool muted_ = false;
+    bool low_battery_shown_ = false;
+    int status_bar_updates_ = 0;
     std::string current_theme_name_;
 
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    struct TextCommand {
+        std::string text;
+        int duration_ms;
+        uint32_t sequence;  // Orders the status and the notification, which hide each other
+    };
+    struct ChatCommand {
+        std::string role;
+        std::string content;
+    };
+    LatestValue<TextCommand> pending_status_;
+    LatestValue<TextCommand> pending_notification_;
+    LatestValue<std::string> pending_emotion_;
+    CommandRing<ChatCommand, 16> pending_chat_messages_;
+    std::atomic<uint32_t> command_sequence_{0};
+    std::atomic<uint32_t> commands_coalesced_{0};
+    std::atomic<bool> command_timer_started_{false};
+    std::atomic<int> pending_refresh_period_{0};
+    int refresh_period_ms_ = LV_DEF_REFR_PERIOD;
+    lv_timer_t* command_timer_ = nullptr;
+
+    // 显示锁等待统计
+    std::atomic<uint32_t> lock_count_{0};
+    std::atomic<uint32_t> lock_wait_us_{0};
+    std::atomic<uint32_t> lock_wait_max_us_{0};
+
+    bool StartCommandTimer();
+    void RunCommands();
+    void RecordLockWait(uint32_t wait_us) {
+        lock_count_.fetch_add(1, std::memory_order_relaxed);
+        lock_wait_us_.fetch_add(wait_us, std::memory_order_relaxed);
+        if (wait_us > lock_wait_max_us_.load(std::memory_order_relaxed)) {
+            lock_wait_max_us_.store(wait_us, std::memory_order_relaxed);
+        }
+    }
+
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
@@ -66,9 +123,11 @@ protected:
 class DisplayLockGuard {
 public:
     DisplayLockGuard(Display *display) : display_(display) {
+        int64_t start_time = esp_timer_get_time();
         if (!display_->Lock(30000)) {
             ESP_LOGE("Display", "Failed to lock display");
         }
+        display_->RecordLockWait(esp_timer_get_time() - start_time);
     }
     ~DisplayLockGuard() {
         display_->Unlock();
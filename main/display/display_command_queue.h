@@ -0,0 +1,95 @@
+#ifndef DISPLAY_COMMAND_QUEUE_H
+#define DISPLAY_COMMAND_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+ * 显示命令的无锁容器，由任意任务写入，只由 LVGL 任务读取
+ *
+ * LatestValue 只保留最新的值，新值会直接替换未处理的旧值（例如状态文本）。
+ * CommandRing 是有界的多生产者队列，保持顺序（例如聊天消息），满时 Push 返回 false。
+ */
+template <typename T>
+class LatestValue {
+public:
+    ~LatestValue() {
+        delete value_.exchange(nullptr);
+    }
+
+    // Returns true if a pending value was superseded
+    bool Put(std::unique_ptr<T> value) {
+        T* old = value_.exchange(value.release(), std::memory_order_acq_rel);
+        delete old;
+        return old != nullptr;
+    }
+
+    std::unique_ptr<T> Take() {
+        return std::unique_ptr<T>(value_.exchange(nullptr, std::memory_order_acq_rel));
+    }
+
+private:
+    std::atomic<T*> value_{nullptr};
+};
+
+// Bounded MPSC queue, each cell carries a sequence number telling whether it is free or filled
+template <typename T, size_t kCapacity>
+class CommandRing {
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    CommandRing() {
+        for (size_t i = 0; i < kCapacity; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool Push(T&& value) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & (kCapacity - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Full
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only called by the consumer task
+    bool Pop(T& value) {
+        Cell* cell = &cells_[dequeue_pos_ & (kCapacity - 1)];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        if ((intptr_t)sequence - (intptr_t)(dequeue_pos_ + 1) < 0) {
+            return false;  // Empty, or the producer has not finished writing
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(dequeue_pos_ + kCapacity, std::memory_order_release);
+        dequeue_pos_++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell cells_[kCapacity];
+    std::atomic<size_t> enqueue_pos_{0};
+    size_t dequeue_pos_ = 0;
+};
+
+#endif // DISPLAY_COMMAND_QUEUE_H
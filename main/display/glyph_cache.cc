@@ -0,0 +1,88 @@
+#include "glyph_cache.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#define TAG "GlyphCache"
+
+// 直接映射，常用汉字加上 ASCII 基本都能放下
+#define GLYPH_CACHE_SIZE_SPIRAM 512
+#define GLYPH_CACHE_SIZE_INTERNAL 64
+
+GlyphCache::GlyphCache(const lv_font_t* base_font) : font_(*base_font), base_font_(base_font) {
+    // Only fonts without kerning give the same glyph regardless of the next letter
+    bool cacheable = base_font->get_glyph_dsc == lv_font_get_glyph_dsc_fmt_txt &&
+        static_cast<const lv_font_fmt_txt_dsc_t*>(base_font->dsc)->kern_dsc == nullptr;
+    if (!cacheable) {
+        ESP_LOGW(TAG, "Font has kerning or is not a fmt_txt font, glyphs are not cached");
+        return;
+    }
+
+    uint32_t size = GLYPH_CACHE_SIZE_SPIRAM;
+    entries_ = (Entry*)heap_caps_calloc(size, sizeof(Entry), MALLOC_CAP_SPIRAM);
+    if (entries_ == nullptr) {
+        size = GLYPH_CACHE_SIZE_INTERNAL;
+        entries_ = (Entry*)heap_caps_calloc(size, sizeof(Entry), MALLOC_CAP_8BIT);
+    }
+    if (entries_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate glyph cache");
+        return;
+    }
+    mask_ = size - 1;
+    font_.get_glyph_dsc = GetGlyphDsc;
+    font_.user_data = this;
+    ESP_LOGI(TAG, "Glyph cache: %u entries, %u bytes", (unsigned)size, (unsigned)(size * sizeof(Entry)));
+}
+
+GlyphCache::~GlyphCache() {
+    if (entries_ != nullptr) {
+        heap_caps_free(entries_);
+    }
+}
+
+bool GlyphCache::GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    auto cache = static_cast<GlyphCache*>(font->user_data);
+    // Letter 0 marks an empty entry
+    if (letter == 0) {
+        return lv_font_get_glyph_dsc_fmt_txt(font, dsc, letter, letter_next);
+    }
+
+    Entry& entry = cache->entries_[letter & cache->mask_];
+    if (entry.letter == letter) {
+        cache->hits_++;
+        *dsc = entry.dsc;
+        return true;
+    }
+
+    cache->misses_++;
+    if (!lv_font_get_glyph_dsc_fmt_txt(font, dsc, letter, letter_next)) {
+        return false;
+    }
+    entry.letter = letter;
+    entry.dsc = *dsc;
+    return true;
+}
+
+int32_t GlyphCache::MeasureWidth(const char* text, int32_t letter_space, int32_t max_width) const {
+    int32_t max_line_width = 0;
+    int32_t line_width = 0;
+    uint32_t i = 0;
+    uint32_t letter = lv_text_encoded_next(text, &i);
+    while (letter != 0) {
+        uint32_t letter_next = lv_text_encoded_next(text, &i);
+        if (letter == '\n') {
+            line_width = 0;
+        } else {
+            line_width += lv_font_get_glyph_width(&font_, letter, letter_next) + letter_space;
+            if (line_width > max_line_width) {
+                max_line_width = line_width;
+                if (max_line_width > max_width) {
+                    // The text wraps anyway, the rest does not change the bubble width
+                    break;
+                }
+            }
+        }
+        letter = letter_next;
+    }
+    return max_line_width;
+}
@@ -0,0 +1,47 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include <lvgl.h>
+
+#include <cstdint>
+
+/*
+ * 字形描述缓存
+ *
+ * 包装一个 lv_font_fmt_txt 字体，缓存每个字符的 glyph 描述（宽度、位图索引等），
+ * 避免中文字体在每次测量和换行时都在几千个字符的 unicode 列表里二分查找。
+ * font() 返回的字体可以直接用于控件，测量和渲染共享同一份缓存。
+ * 带字距调整 (kerning) 的字体结果依赖下一个字符，这类字体不缓存，直接透传。
+ */
+class GlyphCache {
+public:
+    explicit GlyphCache(const lv_font_t* base_font);
+    ~GlyphCache();
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    const lv_font_t* font() const { return &font_; }
+
+    // Width of the widest line, stops as soon as it exceeds max_width
+    int32_t MeasureWidth(const char* text, int32_t letter_space, int32_t max_width) const;
+
+    uint32_t hits() const { return hits_; }
+    uint32_t misses() const { return misses_; }
+
+private:
+    struct Entry {
+        uint32_t letter;
+        lv_font_glyph_dsc_t dsc;
+    };
+
+    static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+
+    lv_font_t font_;
+    const lv_font_t* base_font_;
+    Entry* entries_ = nullptr;
+    uint32_t mask_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+};
+
+#endif // GLYPH_CACHE_H
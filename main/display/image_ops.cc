@@ -0,0 +1,90 @@
+#include "image_ops.h"
+#include "software_image_ops.h"
+#if CONFIG_SOC_PPA_SUPPORTED
+#include "ppa_image_ops.h"
+#endif
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#define TAG "ImageOps"
+
+// 每种操作执行 20 次输出一次耗时统计
+#define IMAGE_OPS_LOG_INTERVAL 20
+
+static const char* const OPERATION_NAMES[] = {"scale", "swap_bytes", "decode_jpeg"};
+
+ImageOps& ImageOps::GetInstance() {
+#if CONFIG_SOC_PPA_SUPPORTED
+    static PpaImageOps instance;
+#else
+    static SoftwareImageOps instance;
+#endif
+    return instance;
+}
+
+uint8_t* ImageOps::AllocBuffer(size_t size) {
+    auto buffer = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buffer == nullptr) {
+        buffer = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    }
+    return buffer;
+}
+
+bool ImageOps::Scale(const lv_img_dsc_t* src, uint8_t* dst, int* width, int* height) {
+    int64_t start_time = esp_timer_get_time();
+    bool success = ScaleRgb565(src, dst, width, height);
+    RecordOperation(kOperationScale, start_time, success);
+    return success;
+}
+
+bool ImageOps::SwapBytes(const uint8_t* src, uint8_t* dst, int width, int height) {
+    int64_t start_time = esp_timer_get_time();
+    bool success = SwapRgb565(src, dst, width, height);
+    RecordOperation(kOperationSwapBytes, start_time, success);
+    return success;
+}
+
+bool ImageOps::DecodeJpeg(const uint8_t* jpeg, size_t jpeg_size, uint8_t* dst, size_t dst_size, int* width, int* height) {
+    int64_t start_time = esp_timer_get_time();
+    bool success = DecodeJpegRgb565(jpeg, jpeg_size, dst, dst_size, width, height);
+    RecordOperation(kOperationDecodeJpeg, start_time, success);
+    return success;
+}
+
+void ImageOps::RecordOperation(Operation operation, int64_t start_time, bool success) {
+    int64_t elapsed = esp_timer_get_time() - start_time;
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    auto& stats = stats_[operation];
+    if (!success) {
+        stats.failures++;
+        return;
+    }
+    stats.count++;
+    stats.total_us += elapsed;
+    if (elapsed > stats.max_us) {
+        stats.max_us = elapsed;
+    }
+    if (stats.count % IMAGE_OPS_LOG_INTERVAL == 0) {
+        ESP_LOGI(TAG, "%s on %s: %u ops, avg %d us, max %d us", OPERATION_NAMES[operation], name(),
+            (unsigned)stats.count, (int)(stats.total_us / stats.count), (int)stats.max_us);
+    }
+}
+
+std::string ImageOps::GetStatsJson() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    std::string json = "{\"backend\":\"";
+    json += name();
+    json += "\"";
+    for (int i = 0; i < kOperationCount; i++) {
+        const auto& stats = stats_[i];
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), ",\"%s\":{\"count\":%u,\"failures\":%u,\"avg_us\":%d,\"max_us\":%d}",
+            OPERATION_NAMES[i], (unsigned)stats.count, (unsigned)stats.failures,
+            stats.count > 0 ? (int)(stats.total_us / stats.count) : 0, (int)stats.max_us);
+        json += buffer;
+    }
+    json += "}";
+    return json;
+}
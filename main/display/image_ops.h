@@ -0,0 +1,60 @@
+#ifndef IMAGE_OPS_H
+#define IMAGE_OPS_H
+
+#include <lvgl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/*
+ * 图像操作后端：RGB565 缩放、字节序转换和 JPEG 解码
+ *
+ * ESP32-P4 上使用 PPA 和硬件 JPEG 解码器，其他芯片使用软件实现，
+ * 硬件不支持的参数（对齐、尺寸等）也会退回软件实现。
+ * 输出缓冲区应通过 AllocBuffer 分配，以满足 DMA 的对齐要求。
+ */
+class ImageOps {
+public:
+    static ImageOps& GetInstance();
+    virtual ~ImageOps() = default;
+
+    virtual const char* name() const = 0;
+    // Allocates an output buffer usable by every operation of this backend, free it with heap_caps_free
+    virtual uint8_t* AllocBuffer(size_t size);
+
+    // Scales src down to at most width x height, the size actually produced is written back
+    bool Scale(const lv_img_dsc_t* src, uint8_t* dst, int* width, int* height);
+    // Converts big-endian RGB565 (camera and JPEG output) to the native byte order
+    bool SwapBytes(const uint8_t* src, uint8_t* dst, int width, int height);
+    // Decodes a JPEG into native RGB565, the image size is written to width and height
+    bool DecodeJpeg(const uint8_t* jpeg, size_t jpeg_size, uint8_t* dst, size_t dst_size, int* width, int* height);
+
+    std::string GetStatsJson();
+
+protected:
+    virtual bool ScaleRgb565(const lv_img_dsc_t* src, uint8_t* dst, int* width, int* height) = 0;
+    virtual bool SwapRgb565(const uint8_t* src, uint8_t* dst, int width, int height) = 0;
+    virtual bool DecodeJpegRgb565(const uint8_t* jpeg, size_t jpeg_size, uint8_t* dst, size_t dst_size, int* width, int* height) = 0;
+
+private:
+    enum Operation {
+        kOperationScale,
+        kOperationSwapBytes,
+        kOperationDecodeJpeg,
+        kOperationCount
+    };
+    struct OperationStats {
+        uint32_t count = 0;
+        uint32_t failures = 0;
+        int64_t total_us = 0;
+        int64_t max_us = 0;
+    };
+    std::mutex stats_mutex_;
+    OperationStats stats_[kOperationCount];
+
+    void RecordOperation(Operation operation, int64_t start_time, bool success);
+};
+
+#endif // IMAGE_OPS_H
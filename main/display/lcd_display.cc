@@ -1,4 +1,5 @@
 #include "lcd_display.h"
+#include "image_ops.h"
 
 #include <vector>
 #include <algorithm>
@@ -7,6 +8,7 @@
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
 #include "assets/lang_config.h"
 #include <cstring>
 #include "settings.h"
@@ -65,13 +67,48 @@ const ThemeColors LIGHT_THEME = {
 };
 
 
+// SPI 屏幕自动选择绘制缓冲区行数时的范围
+#define SPI_LCD_MIN_BUFFER_LINES 10
+#define SPI_LCD_MAX_BUFFER_LINES 60
+
+// 渲染统计窗口长度，每 10 个窗口输出一次日志
+#define RENDER_STATS_WINDOW_MS 1000
+#define RENDER_STATS_LOG_WINDOWS 10
+
 LV_FONT_DECLARE(font_awesome_30_4);
 
+// 计算预览图缩放后的尺寸，保持宽高比，不放大
+static void FitPreviewSize(int src_w, int src_h, int max_w, int max_h, int* w, int* h) {
+    if (src_w * max_h > src_h * max_w) {
+        *w = std::min(src_w, max_w);
+        *h = std::max(1, src_h * *w / src_w);
+    } else {
+        *h = std::min(src_h, max_h);
+        *w = std::max(1, src_w * *h / src_h);
+    }
+}
+
 LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, DisplayFonts fonts, int width, int height)
     : panel_io_(panel_io), panel_(panel), fonts_(fonts) {
     width_ = width;
     height_ = height;
 
+#if CONFIG_USE_FONT_ASSETS
+    // assets 分区中的字体替换编译进固件的文本字体，加载失败时继续使用后者
+    asset_font_ = std::make_unique<AssetFont>(strrchr("/" CONFIG_FONT_ASSETS_PATH, '/') + 1);
+    if (asset_font_->font() != nullptr) {
+        fonts_.text_font = asset_font_->font();
+    } else {
+        asset_font_.reset();
+    }
+#endif
+
+    // 文本字体经过字形缓存，气泡测量和标签换行渲染都会命中
+    if (fonts_.text_font != nullptr) {
+        text_glyph_cache_ = std::make_unique<GlyphCache>(fonts_.text_font);
+        fonts_.text_font = text_glyph_cache_->font();
+    }
+
     // Load theme from settings
     Settings settings("display", false);
     current_theme_name_ = settings.GetString("theme", "light");
@@ -108,13 +145,30 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     port_cfg.timer_period_ms = 50;
     lvgl_port_init(&port_cfg);
 
+    // 双缓冲时 LVGL 渲染下一块区域的同时，上一块区域通过 DMA 发送到屏幕
+#if CONFIG_LCD_SPI_DOUBLE_BUFFER
+    const int buffer_count = 2;
+#else
+    const int buffer_count = 1;
+#endif
+    int buffer_lines = CONFIG_LCD_SPI_BUFFER_LINES;
+    size_t dma_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (buffer_lines == 0) {
+        // Use up to a quarter of the largest free internal DMA block for the draw buffers
+        buffer_lines = dma_largest_block / 4 / (width_ * sizeof(uint16_t) * buffer_count);
+        buffer_lines = std::max(SPI_LCD_MIN_BUFFER_LINES, std::min(buffer_lines, SPI_LCD_MAX_BUFFER_LINES));
+    }
+    buffer_lines = std::min(buffer_lines, height_);
+    ESP_LOGI(TAG, "Draw buffer: %d x %d lines, largest free DMA block %u bytes", buffer_count, buffer_lines,
+        (unsigned)dma_largest_block);
+
     ESP_LOGI(TAG, "Adding LCD display");
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
+        .buffer_size = static_cast<uint32_t>(width_ * buffer_lines),
+        .double_buffer = buffer_count == 2,
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -145,6 +199,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    InstallRenderStats();
     SetupUI();
 }
 
@@ -208,6 +263,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    InstallRenderStats();
     SetupUI();
 }
 
@@ -266,6 +322,7 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    InstallRenderStats();
     SetupUI();
 }
 
@@ -283,9 +340,20 @@ LcdDisplay::~LcdDisplay() {
     if (container_ != nullptr) {
         lv_obj_del(container_);
     }
+    if (theme_styles_ready_) {
+        lv_style_reset(&theme_styles_.background);
+        lv_style_reset(&theme_styles_.chat_background);
+        lv_style_reset(&theme_styles_.user_bubble);
+        lv_style_reset(&theme_styles_.assistant_bubble);
+        lv_style_reset(&theme_styles_.system_bubble);
+        lv_style_reset(&theme_styles_.low_battery);
+    }
     if (display_ != nullptr) {
         lv_display_delete(display_);
     }
+    if (preview_buffer_ != nullptr) {
+        heap_caps_free(preview_buffer_);
+    }
 
     if (panel_ != nullptr) {
         esp_lcd_panel_del(panel_);
@@ -295,6 +363,165 @@ LcdDisplay::~LcdDisplay() {
     }
 }
 
+void LcdDisplay::InstallRenderStats() {
+    DisplayLockGuard lock(this);
+    auto callback = [](lv_event_t* e) {
+        auto display = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        auto& stats = display->render_stats_;
+        int64_t now = esp_timer_get_time();
+        switch (lv_event_get_code(e)) {
+        case LV_EVENT_INVALIDATE_AREA:
+            stats.invalidated_px += lv_area_get_size(static_cast<const lv_area_t*>(lv_event_get_param(e)));
+            break;
+        case LV_EVENT_RENDER_START:
+            stats.render_start = now;
+            break;
+        case LV_EVENT_RENDER_READY:
+            stats.frames++;
+            stats.render_us += now - stats.render_start;
+            break;
+        case LV_EVENT_FLUSH_WAIT_START:
+            stats.flush_wait_start = now;
+            break;
+        case LV_EVENT_FLUSH_WAIT_FINISH:
+            stats.flush_wait_us += now - stats.flush_wait_start;
+            stats.flush_wait_max_us = std::max(stats.flush_wait_max_us, now - stats.flush_wait_start);
+            break;
+        default:
+            break;
+        }
+    };
+    render_stats_.period_start = esp_timer_get_time();
+    lv_display_add_event_cb(display_, callback, LV_EVENT_INVALIDATE_AREA, this);
+    lv_display_add_event_cb(display_, callback, LV_EVENT_RENDER_START, this);
+    lv_display_add_event_cb(display_, callback, LV_EVENT_RENDER_READY, this);
+    lv_display_add_event_cb(display_, callback, LV_EVENT_FLUSH_WAIT_START, this);
+    lv_display_add_event_cb(display_, callback, LV_EVENT_FLUSH_WAIT_FINISH, this);
+
+    // 每秒结算一次统计窗口，供日志、性能浮层和 MCP 工具读取
+    lv_timer_create([](lv_timer_t* timer) {
+        auto display = static_cast<LcdDisplay*>(lv_timer_get_user_data(timer));
+        display->UpdateRenderSnapshot();
+    }, RENDER_STATS_WINDOW_MS, this);
+}
+
+// Runs in the LVGL task
+void LcdDisplay::UpdateRenderSnapshot() {
+    auto& stats = render_stats_;
+    int64_t now = esp_timer_get_time();
+    int64_t period_us = std::max<int64_t>(now - stats.period_start, 1);
+    auto& snapshot = render_snapshot_;
+    snapshot.fps_x10 = (int)(stats.frames * 10000000LL / period_us);
+    snapshot.render_avg_us = stats.frames > 0 ? (int)(stats.render_us / stats.frames) : 0;
+    snapshot.flush_wait_avg_us = stats.frames > 0 ? (int)(stats.flush_wait_us / stats.frames) : 0;
+    snapshot.flush_wait_max_us = (int)stats.flush_wait_max_us;
+    snapshot.invalidated_px_per_s = (int)(stats.invalidated_px * 1000000LL / period_us);
+    stats = RenderStats();
+    stats.period_start = now;
+
+    if (++snapshot.windows % RENDER_STATS_LOG_WINDOWS == 0 && snapshot.fps_x10 > 0) {
+        ESP_LOGI(TAG, "Render: %d.%d fps (period %d ms), render avg %d us, flush wait avg %d us max %d us, invalidated %d px/s",
+            snapshot.fps_x10 / 10, snapshot.fps_x10 % 10, refresh_period_ms_, snapshot.render_avg_us,
+            snapshot.flush_wait_avg_us, snapshot.flush_wait_max_us, snapshot.invalidated_px_per_s);
+    }
+
+    if (perf_hud_ != nullptr) {
+        uint32_t lock_count = lock_count_.load();
+        lv_label_set_text_fmt(perf_hud_, "%d.%d fps  render %d us\nflush wait %d us  inv %d px/s\nlock wait %d us  heap %uK",
+            snapshot.fps_x10 / 10, snapshot.fps_x10 % 10, snapshot.render_avg_us, snapshot.flush_wait_avg_us,
+            snapshot.invalidated_px_per_s, (int)(lock_count > 0 ? lock_wait_us_.load() / lock_count : 0),
+            (unsigned)(heap_caps_get_free_size(MALLOC_CAP_8BIT) / 1024));
+    }
+}
+
+void LcdDisplay::SetPerfHudVisible(bool visible) {
+    DisplayLockGuard lock(this);
+    if (!visible) {
+        if (perf_hud_ != nullptr) {
+            lv_obj_del(perf_hud_);
+            perf_hud_ = nullptr;
+        }
+        return;
+    }
+    if (perf_hud_ != nullptr) {
+        return;
+    }
+    // 放在顶层，不影响聊天界面的布局，内容由统计定时器每秒刷新
+    perf_hud_ = lv_label_create(lv_layer_top());
+    lv_obj_set_style_text_font(perf_hud_, fonts_.text_font, 0);
+    lv_obj_set_style_text_color(perf_hud_, lv_color_white(), 0);
+    lv_obj_set_style_bg_color(perf_hud_, lv_color_black(), 0);
+    lv_obj_set_style_bg_opa(perf_hud_, LV_OPA_60, 0);
+    lv_obj_set_style_pad_all(perf_hud_, 2, 0);
+    lv_obj_align(perf_hud_, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+    lv_label_set_text(perf_hud_, "");
+}
+
+std::string LcdDisplay::GetPerfStatsJson() {
+    auto json = Display::GetPerfStatsJson();
+    RenderSnapshot snapshot;
+    {
+        DisplayLockGuard lock(this);
+        snapshot = render_snapshot_;
+    }
+    char buffer[192];
+    snprintf(buffer, sizeof(buffer), ",\"render\":{\"fps\":%d.%d,\"render_avg_us\":%d,\"flush_wait_avg_us\":%d,"
+        "\"flush_wait_max_us\":%d,\"invalidated_px_per_s\":%d}", snapshot.fps_x10 / 10, snapshot.fps_x10 % 10,
+        snapshot.render_avg_us, snapshot.flush_wait_avg_us, snapshot.flush_wait_max_us, snapshot.invalidated_px_per_s);
+    json.pop_back();
+    json += buffer;
+    json += ",\"image_ops\":" + ImageOps::GetInstance().GetStatsJson() + "}";
+    return json;
+}
+
+void LcdDisplay::InitThemeStyles() {
+    if (theme_styles_ready_) {
+        return;
+    }
+    lv_style_init(&theme_styles_.background);
+    lv_style_init(&theme_styles_.chat_background);
+    lv_style_init(&theme_styles_.user_bubble);
+    lv_style_init(&theme_styles_.assistant_bubble);
+    lv_style_init(&theme_styles_.system_bubble);
+    lv_style_init(&theme_styles_.low_battery);
+    UpdateThemeStyles();
+    theme_styles_ready_ = true;
+}
+
+void LcdDisplay::UpdateThemeStyles() {
+    lv_style_set_bg_color(&theme_styles_.background, current_theme_.background);
+    lv_style_set_text_color(&theme_styles_.background, current_theme_.text);
+    lv_style_set_border_color(&theme_styles_.background, current_theme_.border);
+
+    lv_style_set_bg_color(&theme_styles_.chat_background, current_theme_.chat_background);
+    lv_style_set_text_color(&theme_styles_.chat_background, current_theme_.text);
+    lv_style_set_border_color(&theme_styles_.chat_background, current_theme_.border);
+
+    // 气泡中的文本标签继承气泡的文本颜色
+    lv_style_set_bg_color(&theme_styles_.user_bubble, current_theme_.user_bubble);
+    lv_style_set_text_color(&theme_styles_.user_bubble, current_theme_.text);
+    lv_style_set_border_color(&theme_styles_.user_bubble, current_theme_.border);
+
+    lv_style_set_bg_color(&theme_styles_.assistant_bubble, current_theme_.assistant_bubble);
+    lv_style_set_text_color(&theme_styles_.assistant_bubble, current_theme_.text);
+    lv_style_set_border_color(&theme_styles_.assistant_bubble, current_theme_.border);
+
+    lv_style_set_bg_color(&theme_styles_.system_bubble, current_theme_.system_bubble);
+    lv_style_set_text_color(&theme_styles_.system_bubble, current_theme_.system_text);
+    lv_style_set_border_color(&theme_styles_.system_bubble, current_theme_.border);
+
+    lv_style_set_bg_color(&theme_styles_.low_battery, current_theme_.low_battery);
+}
+
+lv_style_t* LcdDisplay::GetBubbleStyle(const char* bubble_type) {
+    if (strcmp(bubble_type, "user") == 0) {
+        return &theme_styles_.user_bubble;
+    } else if (strcmp(bubble_type, "system") == 0) {
+        return &theme_styles_.system_bubble;
+    }
+    return &theme_styles_.assistant_bubble;
+}
+
 bool LcdDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
@@ -307,10 +534,11 @@ void LcdDisplay::Unlock() {
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
 
+    InitThemeStyles();
+
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
-    lv_obj_set_style_text_color(screen, current_theme_.text, 0);
-    lv_obj_set_style_bg_color(screen, current_theme_.background, 0);
+    lv_obj_add_style(screen, &theme_styles_.background, 0);
 
     /* Container */
     container_ = lv_obj_create(screen);
@@ -319,15 +547,13 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_pad_all(container_, 0, 0);
     lv_obj_set_style_border_width(container_, 0, 0);
     lv_obj_set_style_pad_row(container_, 0, 0);
-    lv_obj_set_style_bg_color(container_, current_theme_.background, 0);
-    lv_obj_set_style_border_color(container_, current_theme_.border, 0);
+    lv_obj_add_style(container_, &theme_styles_.background, 0);
 
     /* Status bar */
     status_bar_ = lv_obj_create(container_);
     lv_obj_set_size(status_bar_, LV_HOR_RES, LV_SIZE_CONTENT);
     lv_obj_set_style_radius(status_bar_, 0, 0);
-    lv_obj_set_style_bg_color(status_bar_, current_theme_.background, 0);
-    lv_obj_set_style_text_color(status_bar_, current_theme_.text, 0);
+    lv_obj_add_style(status_bar_, &theme_styles_.background, 0);
     
     /* Content - Chat area */
     content_ = lv_obj_create(container_);
@@ -335,8 +561,7 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_width(content_, LV_HOR_RES);
     lv_obj_set_flex_grow(content_, 1);
     lv_obj_set_style_pad_all(content_, 10, 0);
-    lv_obj_set_style_bg_color(content_, current_theme_.chat_background, 0); // Background for chat area
-    lv_obj_set_style_border_color(content_, current_theme_.border, 0); // Border color for chat area
+    lv_obj_add_style(content_, &theme_styles_.chat_background, 0); // Background for chat area
 
     // Enable scrolling for chat content
     lv_obj_set_scrollbar_mode(content_, LV_SCROLLBAR_MODE_OFF);
@@ -366,14 +591,12 @@ void LcdDisplay::SetupUI() {
     // 创建emotion_label_在状态栏最左侧
     emotion_label_ = lv_label_create(status_bar_);
     lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
-    lv_obj_set_style_text_color(emotion_label_, current_theme_.text, 0);
     lv_label_set_text(emotion_label_, FONT_AWESOME_AI_CHIP);
     lv_obj_set_style_margin_right(emotion_label_, 5, 0); // 添加右边距，与后面的元素分隔
 
     notification_label_ = lv_label_create(status_bar_);
     lv_obj_set_flex_grow(notification_label_, 1);
     lv_obj_set_style_text_align(notification_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(notification_label_, current_theme_.text, 0);
     lv_label_set_text(notification_label_, "");
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
 
@@ -381,31 +604,27 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_grow(status_label_, 1);
     lv_label_set_long_mode(status_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
     lv_obj_set_style_text_align(status_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(status_label_, current_theme_.text, 0);
     lv_label_set_text(status_label_, Lang::Strings::INITIALIZING);
     
     mute_label_ = lv_label_create(status_bar_);
     lv_label_set_text(mute_label_, "");
     lv_obj_set_style_text_font(mute_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(mute_label_, current_theme_.text, 0);
 
     network_label_ = lv_label_create(status_bar_);
     lv_label_set_text(network_label_, "");
     lv_obj_set_style_text_font(network_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(network_label_, current_theme_.text, 0);
     lv_obj_set_style_margin_left(network_label_, 5, 0); // 添加左边距，与前面的元素分隔
 
     battery_label_ = lv_label_create(status_bar_);
     lv_label_set_text(battery_label_, "");
     lv_obj_set_style_text_font(battery_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(battery_label_, current_theme_.text, 0);
     lv_obj_set_style_margin_left(battery_label_, 5, 0); // 添加左边距，与前面的元素分隔
 
     low_battery_popup_ = lv_obj_create(screen);
     lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_size(low_battery_popup_, LV_HOR_RES * 0.9, fonts_.text_font->line_height * 2);
     lv_obj_align(low_battery_popup_, LV_ALIGN_BOTTOM_MID, 0, 0);
-    lv_obj_set_style_bg_color(low_battery_popup_, current_theme_.low_battery, 0);
+    lv_obj_add_style(low_battery_popup_, &theme_styles_.low_battery, 0);
     lv_obj_set_style_radius(low_battery_popup_, 10, 0);
     low_battery_label_ = lv_label_create(low_battery_popup_);
     lv_label_set_text(low_battery_label_, Lang::Strings::BATTERY_NEED_CHARGE);
@@ -418,6 +637,71 @@ void LcdDisplay::SetupUI() {
 #else
 #define  MAX_MESSAGES 20
 #endif
+// 消息行的标记，用于区分回收池中的消息和图片气泡
+#define MESSAGE_ROW_FLAG LV_OBJ_FLAG_USER_1
+
+void LcdDisplay::RemoveOldestMessage() {
+    lv_obj_t* first_child = lv_obj_get_child(content_, 0);
+    if (first_child == nullptr) {
+        return;
+    }
+    if (lv_obj_has_flag(first_child, MESSAGE_ROW_FLAG)) {
+        // 释放回收池中的位置，下次创建消息行时复用
+        auto& slot = message_slots_[(uintptr_t)lv_obj_get_user_data(first_child)];
+        if (chat_message_label_ == slot.label) {
+            chat_message_label_ = nullptr;
+        }
+        slot.row = nullptr;
+    }
+    lv_obj_del(first_child);
+}
+
+LcdDisplay::MessageSlot* LcdDisplay::AcquireMessageSlot() {
+    // 达到数量上限时，最早的是消息行就回收它，是图片气泡就删除它
+    while (lv_obj_get_child_cnt(content_) >= MAX_MESSAGES) {
+        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
+        if (lv_obj_has_flag(first_child, MESSAGE_ROW_FLAG)) {
+            lv_obj_move_foreground(first_child);
+            return &message_slots_[(uintptr_t)lv_obj_get_user_data(first_child)];
+        }
+        RemoveOldestMessage();
+    }
+
+    // Reuse the slot of a deleted row, the pool never grows past MAX_MESSAGES
+    size_t index = 0;
+    while (index < message_slots_.size() && message_slots_[index].row != nullptr) {
+        index++;
+    }
+    if (index == message_slots_.size()) {
+        message_slots_.push_back({});
+    }
+
+    // Create a full-width transparent row, the bubble is aligned inside it by role
+    MessageSlot& slot = message_slots_[index];
+    slot.row = lv_obj_create(content_);
+    lv_obj_add_flag(slot.row, MESSAGE_ROW_FLAG);
+    lv_obj_set_user_data(slot.row, (void*)(uintptr_t)index);
+    lv_obj_set_width(slot.row, LV_HOR_RES);
+    lv_obj_set_height(slot.row, LV_SIZE_CONTENT);
+    lv_obj_set_scrollbar_mode(slot.row, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_bg_opa(slot.row, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_width(slot.row, 0, 0);
+    lv_obj_set_style_pad_all(slot.row, 0, 0);
+
+    slot.bubble = lv_obj_create(slot.row);
+    lv_obj_set_style_radius(slot.bubble, 8, 0);
+    lv_obj_set_scrollbar_mode(slot.bubble, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_border_width(slot.bubble, 1, 0);
+    lv_obj_set_style_pad_all(slot.bubble, 8, 0);
+    lv_obj_set_size(slot.bubble, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+    lv_obj_set_style_flex_grow(slot.bubble, 0, 0);
+
+    slot.label = lv_label_create(slot.bubble);
+    lv_label_set_long_mode(slot.label, LV_LABEL_LONG_WRAP);
+    lv_obj_set_style_text_font(slot.label, fonts_.text_font, 0);
+    return &slot;
+}
+
 void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (content_ == nullptr) {
@@ -426,179 +710,91 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     
     //避免出现空的消息框
     if(strlen(content) == 0) return;
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
+
+    int64_t start_time = esp_timer_get_time();
+
+    // 气泡类型使用静态字符串，切换主题时根据它设置颜色
+    const char* bubble_type;
+    if (strcmp(role, "user") == 0) {
+        bubble_type = "user";
+    } else if (strcmp(role, "system") == 0) {
+        bubble_type = "system";
+    } else {
+        bubble_type = "assistant";
+    }
+
+    // 折叠系统消息（如果最后一个消息也是系统消息，直接替换它的文本）
+    MessageSlot* slot = nullptr;
+    lv_obj_t* last_child = lv_obj_get_child(content_, -1);
+    if (bubble_type[0] == 's' && last_child != nullptr && lv_obj_has_flag(last_child, MESSAGE_ROW_FLAG)) {
+        auto last_slot = &message_slots_[(uintptr_t)lv_obj_get_user_data(last_child)];
+        if (lv_obj_get_user_data(last_slot->bubble) == bubble_type) {
+            slot = last_slot;
         }
     }
-    
-    // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
-    if (strcmp(role, "system") == 0 && child_count > 0) {
-        // 获取最后一个消息容器
-        lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-        if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-            // 获取容器内的气泡
-            lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-            if (last_bubble != nullptr) {
-                // 检查气泡类型是否为系统消息
-                void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                    // 如果最后一个消息也是系统消息，则删除它
-                    lv_obj_del(last_container);
-                }
-            }
+    if (slot == nullptr) {
+        slot = AcquireMessageSlot();
+        if (slot == nullptr) {
+            return;
         }
     }
-    
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 1, 0);
-    lv_obj_set_style_border_color(msg_bubble, current_theme_.border, 0);
-    lv_obj_set_style_pad_all(msg_bubble, 8, 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
+
+    lv_label_set_text(slot->label, content);
 
     // 计算气泡宽度
     lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
-    }
 
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
+    // 计算文本实际宽度，超过最大宽度后不再继续测量
+    lv_coord_t text_width;
+    if (text_glyph_cache_ != nullptr) {
+        text_width = text_glyph_cache_->MeasureWidth(content, 0, max_width);
     } else {
-        bubble_width = max_width;
+        lv_point_t text_size;
+        lv_text_get_size(&text_size, content, fonts_.text_font, 0, 0, LV_COORD_MAX, LV_TEXT_FLAG_NONE);
+        text_width = text_size.x;
     }
-    
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-    lv_obj_set_style_text_font(msg_text, fonts_.text_font, 0);
-
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.user_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.assistant_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.system_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.system_text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+    lv_coord_t min_width = 20;  
+    lv_coord_t bubble_width = std::max(min_width, std::min(text_width, max_width));
+    lv_obj_set_width(slot->label, bubble_width);
+
+    // The style only changes when a recycled bubble gets another role
+    auto old_type = static_cast<const char*>(lv_obj_get_user_data(slot->bubble));
+    if (old_type != bubble_type) {
+        if (old_type != nullptr) {
+            lv_obj_remove_style(slot->bubble, GetBubbleStyle(old_type), 0);
+        }
+        lv_obj_set_user_data(slot->bubble, (void*)bubble_type);
+        lv_obj_add_style(slot->bubble, GetBubbleStyle(bubble_type), 0);
+        if (bubble_type[0] == 'u') {
+            // User messages are right-aligned with green background
+            lv_obj_align(slot->bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+        } else if (bubble_type[0] == 's') {
+            // System messages are center-aligned with light gray background
+            lv_obj_align(slot->bubble, LV_ALIGN_CENTER, 0, 0);
+        } else {
+            // Assistant messages are left-aligned with white background
+            lv_obj_align(slot->bubble, LV_ALIGN_LEFT_MID, 0, 0);
+        }
     }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
-    }
-    
+    // Auto-scroll to this message
+    lv_obj_scroll_to_view_recursive(slot->row, LV_ANIM_ON);
+
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = slot->label;
+
+    int64_t elapsed = esp_timer_get_time() - start_time;
+    message_time_total_ += elapsed;
+    message_time_max_ = std::max(message_time_max_, elapsed);
+    if (++message_count_ % 50 == 0) {
+        ESP_LOGI(TAG, "Chat messages: %u, %u bubbles, set avg %d us, max %d us, glyph cache %u hits %u misses, free heap %u",
+            (unsigned)message_count_, (unsigned)message_slots_.size(), (int)(message_time_total_ / 50), (int)message_time_max_,
+            (unsigned)(text_glyph_cache_ ? text_glyph_cache_->hits() : 0),
+            (unsigned)(text_glyph_cache_ ? text_glyph_cache_->misses() : 0),
+            (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT));
+        message_time_total_ = 0;
+        message_time_max_ = 0;
+    }
 }
 
 void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
@@ -608,16 +804,20 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
     }
     
     if (img_dsc != nullptr) {
+        // Image bubbles count against the same limit as the messages
+        while (lv_obj_get_child_cnt(content_) >= MAX_MESSAGES) {
+            RemoveOldestMessage();
+        }
+
         // Create a message bubble for image preview
         lv_obj_t* img_bubble = lv_obj_create(content_);
         lv_obj_set_style_radius(img_bubble, 8, 0);
         lv_obj_set_scrollbar_mode(img_bubble, LV_SCROLLBAR_MODE_OFF);
         lv_obj_set_style_border_width(img_bubble, 1, 0);
-        lv_obj_set_style_border_color(img_bubble, current_theme_.border, 0);
         lv_obj_set_style_pad_all(img_bubble, 8, 0);
         
-        // Set image bubble background color (similar to system message)
-        lv_obj_set_style_bg_color(img_bubble, current_theme_.assistant_bubble, 0);
+        // Image bubbles share the assistant message style
+        lv_obj_add_style(img_bubble, &theme_styles_.assistant_bubble, 0);
         
         // 设置自定义属性标记气泡类型
         lv_obj_set_user_data(img_bubble, (void*)"image");
@@ -637,25 +837,47 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
         copied_img_dsc->header = img_dsc->header;
         copied_img_dsc->data_size = img_dsc->data_size;
         
-        // Copy the image data
-        uint8_t* copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (copied_data == nullptr) {
-            // Fallback to internal RAM if SPIRAM allocation fails
-            copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_8BIT);
+        // Calculate appropriate size for the image
+        lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
+        lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
+
+        // RGB565 images are scaled down while copying and drawn 1:1
+        int64_t start_time = esp_timer_get_time();
+        auto& image_ops = ImageOps::GetInstance();
+        bool scale_on_copy = img_dsc->header.cf == LV_COLOR_FORMAT_RGB565;
+        int scaled_w = 0, scaled_h = 0;
+        if (scale_on_copy) {
+            FitPreviewSize(img_dsc->header.w, img_dsc->header.h, max_width, max_height, &scaled_w, &scaled_h);
+            copied_img_dsc->data_size = scaled_w * scaled_h * 2;
         }
+        
+        // Copy the image data
+        uint8_t* copied_data = image_ops.AllocBuffer(copied_img_dsc->data_size);
         if (copied_data == nullptr) {
-            ESP_LOGE(TAG, "Failed to allocate memory for image data (size: %lu bytes)", img_dsc->data_size);
+            ESP_LOGE(TAG, "Failed to allocate memory for image data (size: %lu bytes)", copied_img_dsc->data_size);
             heap_caps_free(copied_img_dsc);
             lv_obj_del(img_bubble);
             return;
         }
         
-        memcpy(copied_data, img_dsc->data, img_dsc->data_size);
+        if (scale_on_copy && image_ops.Scale(img_dsc, copied_data, &scaled_w, &scaled_h)) {
+            copied_img_dsc->header.w = scaled_w;
+            copied_img_dsc->header.h = scaled_h;
+            copied_img_dsc->header.stride = scaled_w * 2;
+            copied_img_dsc->data_size = scaled_w * scaled_h * 2;
+        } else if (scale_on_copy) {
+            ESP_LOGE(TAG, "Failed to scale the image");
+            heap_caps_free(copied_data);
+            heap_caps_free(copied_img_dsc);
+            lv_obj_del(img_bubble);
+            return;
+        } else {
+            memcpy(copied_data, img_dsc->data, img_dsc->data_size);
+        }
         copied_img_dsc->data = copied_data;
-        
-        // Calculate appropriate size for the image
-        lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
-        lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
+        ESP_LOGI(TAG, "Preview %dx%d copied as %dx%d in %d us by %s, %lu bytes", (int)img_dsc->header.w, (int)img_dsc->header.h,
+            (int)copied_img_dsc->header.w, (int)copied_img_dsc->header.h, (int)(esp_timer_get_time() - start_time),
+            image_ops.name(), copied_img_dsc->data_size);
         
         // Calculate zoom factor to fit within maximum dimensions
         lv_coord_t img_width = copied_img_dsc->header.w;
@@ -666,7 +888,7 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
         lv_coord_t zoom = (zoom_w < zoom_h) ? zoom_w : zoom_h;
         
         // Ensure zoom doesn't exceed 256 (100%)
-        if (zoom > 256) zoom = 256;
+        if (zoom > 256 || scale_on_copy) zoom = 256;
         
         // Set image properties
         lv_image_set_src(preview_image, copied_img_dsc);
@@ -706,10 +928,11 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
 
+    InitThemeStyles();
+
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
-    lv_obj_set_style_text_color(screen, current_theme_.text, 0);
-    lv_obj_set_style_bg_color(screen, current_theme_.background, 0);
+    lv_obj_add_style(screen, &theme_styles_.background, 0);
 
     /* Container */
     container_ = lv_obj_create(screen);
@@ -718,15 +941,13 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_pad_all(container_, 0, 0);
     lv_obj_set_style_border_width(container_, 0, 0);
     lv_obj_set_style_pad_row(container_, 0, 0);
-    lv_obj_set_style_bg_color(container_, current_theme_.background, 0);
-    lv_obj_set_style_border_color(container_, current_theme_.border, 0);
+    lv_obj_add_style(container_, &theme_styles_.background, 0);
 
     /* Status bar */
     status_bar_ = lv_obj_create(container_);
     lv_obj_set_size(status_bar_, LV_HOR_RES, fonts_.text_font->line_height);
     lv_obj_set_style_radius(status_bar_, 0, 0);
-    lv_obj_set_style_bg_color(status_bar_, current_theme_.background, 0);
-    lv_obj_set_style_text_color(status_bar_, current_theme_.text, 0);
+    lv_obj_add_style(status_bar_, &theme_styles_.background, 0);
     
     /* Content */
     content_ = lv_obj_create(container_);
@@ -735,15 +956,13 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_width(content_, LV_HOR_RES);
     lv_obj_set_flex_grow(content_, 1);
     lv_obj_set_style_pad_all(content_, 5, 0);
-    lv_obj_set_style_bg_color(content_, current_theme_.chat_background, 0);
-    lv_obj_set_style_border_color(content_, current_theme_.border, 0); // Border color for content
+    lv_obj_add_style(content_, &theme_styles_.chat_background, 0);
 
     lv_obj_set_flex_flow(content_, LV_FLEX_FLOW_COLUMN); // 垂直布局（从上到下）
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_SPACE_EVENLY); // 子对象居中对齐，等距分布
 
     emotion_label_ = lv_label_create(content_);
     lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
-    lv_obj_set_style_text_color(emotion_label_, current_theme_.text, 0);
     lv_label_set_text(emotion_label_, FONT_AWESOME_AI_CHIP);
 
     preview_image_ = lv_image_create(content_);
@@ -756,7 +975,6 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_width(chat_message_label_, LV_HOR_RES * 0.9); // 限制宽度为屏幕宽度的 90%
     lv_label_set_long_mode(chat_message_label_, LV_LABEL_LONG_WRAP); // 设置为自动换行模式
     lv_obj_set_style_text_align(chat_message_label_, LV_TEXT_ALIGN_CENTER, 0); // 设置文本居中对齐
-    lv_obj_set_style_text_color(chat_message_label_, current_theme_.text, 0);
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -769,12 +987,10 @@ void LcdDisplay::SetupUI() {
     network_label_ = lv_label_create(status_bar_);
     lv_label_set_text(network_label_, "");
     lv_obj_set_style_text_font(network_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(network_label_, current_theme_.text, 0);
 
     notification_label_ = lv_label_create(status_bar_);
     lv_obj_set_flex_grow(notification_label_, 1);
     lv_obj_set_style_text_align(notification_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(notification_label_, current_theme_.text, 0);
     lv_label_set_text(notification_label_, "");
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
 
@@ -782,23 +998,20 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_grow(status_label_, 1);
     lv_label_set_long_mode(status_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
     lv_obj_set_style_text_align(status_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(status_label_, current_theme_.text, 0);
     lv_label_set_text(status_label_, Lang::Strings::INITIALIZING);
     mute_label_ = lv_label_create(status_bar_);
     lv_label_set_text(mute_label_, "");
     lv_obj_set_style_text_font(mute_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(mute_label_, current_theme_.text, 0);
 
     battery_label_ = lv_label_create(status_bar_);
     lv_label_set_text(battery_label_, "");
     lv_obj_set_style_text_font(battery_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(battery_label_, current_theme_.text, 0);
 
     low_battery_popup_ = lv_obj_create(screen);
     lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_size(low_battery_popup_, LV_HOR_RES * 0.9, fonts_.text_font->line_height * 2);
     lv_obj_align(low_battery_popup_, LV_ALIGN_BOTTOM_MID, 0, 0);
-    lv_obj_set_style_bg_color(low_battery_popup_, current_theme_.low_battery, 0);
+    lv_obj_add_style(low_battery_popup_, &theme_styles_.low_battery, 0);
     lv_obj_set_style_radius(low_battery_popup_, 10, 0);
     low_battery_label_ = lv_label_create(low_battery_popup_);
     lv_label_set_text(low_battery_label_, Lang::Strings::BATTERY_NEED_CHARGE);
@@ -807,6 +1020,39 @@ void LcdDisplay::SetupUI() {
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
 }
 
+bool LcdDisplay::CopyScaledPreview(const lv_img_dsc_t* img_dsc, int max_width, int max_height) {
+    int64_t start_time = esp_timer_get_time();
+    auto& image_ops = ImageOps::GetInstance();
+    int width, height;
+    FitPreviewSize(img_dsc->header.w, img_dsc->header.h, max_width, max_height, &width, &height);
+    size_t size = width * height * 2;
+    if (size > preview_buffer_size_) {
+        heap_caps_free(preview_buffer_);
+        preview_buffer_ = image_ops.AllocBuffer(size);
+        if (preview_buffer_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate preview buffer (size: %u bytes)", (unsigned)size);
+            preview_buffer_size_ = 0;
+            return false;
+        }
+        preview_buffer_size_ = size;
+    }
+
+    if (!image_ops.Scale(img_dsc, preview_buffer_, &width, &height)) {
+        return false;
+    }
+    memset(&preview_copy_, 0, sizeof(preview_copy_));
+    preview_copy_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    preview_copy_.header.cf = LV_COLOR_FORMAT_RGB565;
+    preview_copy_.header.w = width;
+    preview_copy_.header.h = height;
+    preview_copy_.header.stride = width * 2;
+    preview_copy_.data_size = width * height * 2;
+    preview_copy_.data = preview_buffer_;
+    ESP_LOGI(TAG, "Preview %dx%d copied as %dx%d in %d us by %s, buffer %u bytes", (int)img_dsc->header.w, (int)img_dsc->header.h,
+        width, height, (int)(esp_timer_get_time() - start_time), image_ops.name(), (unsigned)preview_buffer_size_);
+    return true;
+}
+
 void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
     DisplayLockGuard lock(this);
     if (preview_image_ == nullptr) {
@@ -814,10 +1060,19 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
     }
     
     if (img_dsc != nullptr) {
-        // zoom factor 0.5
-        lv_image_set_scale(preview_image_, 128 * width_ / img_dsc->header.w);
-        // 设置图片源并显示预览图片
-        lv_image_set_src(preview_image_, img_dsc);
+        if (img_dsc->header.cf == LV_COLOR_FORMAT_RGB565 && CopyScaledPreview(img_dsc, width_ / 2, height_ / 2)) {
+            // 已经缩小到控件大小，按 1:1 绘制
+            lv_image_set_scale(preview_image_, LV_SCALE_NONE);
+            // The buffer is reused, drop what LVGL cached for the previous frame
+            lv_image_cache_drop(&preview_copy_);
+            lv_image_set_src(preview_image_, &preview_copy_);
+            lv_obj_invalidate(preview_image_);
+        } else {
+            // zoom factor 0.5
+            lv_image_set_scale(preview_image_, 128 * width_ / img_dsc->header.w);
+            // 设置图片源并显示预览图片
+            lv_image_set_src(preview_image_, img_dsc);
+        }
         lv_obj_clear_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
         // 隐藏emotion_label_
         if (emotion_label_ != nullptr) {
@@ -919,183 +1174,14 @@ void LcdDisplay::SetTheme(const std::string& theme_name) {
         ESP_LOGE(TAG, "Invalid theme name: %s", theme_name.c_str());
         return;
     }
-    
-    // Get the active screen
-    lv_obj_t* screen = lv_screen_active();
-    
-    // Update the screen colors
-    lv_obj_set_style_bg_color(screen, current_theme_.background, 0);
-    lv_obj_set_style_text_color(screen, current_theme_.text, 0);
-    
-    // Update container colors
-    if (container_ != nullptr) {
-        lv_obj_set_style_bg_color(container_, current_theme_.background, 0);
-        lv_obj_set_style_border_color(container_, current_theme_.border, 0);
-    }
-    
-    // Update status bar colors
-    if (status_bar_ != nullptr) {
-        lv_obj_set_style_bg_color(status_bar_, current_theme_.background, 0);
-        lv_obj_set_style_text_color(status_bar_, current_theme_.text, 0);
-        
-        // Update status bar elements
-        if (network_label_ != nullptr) {
-            lv_obj_set_style_text_color(network_label_, current_theme_.text, 0);
-        }
-        if (status_label_ != nullptr) {
-            lv_obj_set_style_text_color(status_label_, current_theme_.text, 0);
-        }
-        if (notification_label_ != nullptr) {
-            lv_obj_set_style_text_color(notification_label_, current_theme_.text, 0);
-        }
-        if (mute_label_ != nullptr) {
-            lv_obj_set_style_text_color(mute_label_, current_theme_.text, 0);
-        }
-        if (battery_label_ != nullptr) {
-            lv_obj_set_style_text_color(battery_label_, current_theme_.text, 0);
-        }
-        if (emotion_label_ != nullptr) {
-            lv_obj_set_style_text_color(emotion_label_, current_theme_.text, 0);
-        }
-    }
-    
-    // Update content area colors
-    if (content_ != nullptr) {
-        lv_obj_set_style_bg_color(content_, current_theme_.chat_background, 0);
-        lv_obj_set_style_border_color(content_, current_theme_.border, 0);
-        
-        // If we have the chat message style, update all message bubbles
-#if CONFIG_USE_WECHAT_MESSAGE_STYLE
-        // Iterate through all children of content (message containers or bubbles)
-        uint32_t child_count = lv_obj_get_child_cnt(content_);
-        for (uint32_t i = 0; i < child_count; i++) {
-            lv_obj_t* obj = lv_obj_get_child(content_, i);
-            if (obj == nullptr) continue;
-            
-            lv_obj_t* bubble = nullptr;
-            
-            // 检查这个对象是容器还是气泡
-            // 如果是容器（用户或系统消息），则获取其子对象作为气泡
-            // 如果是气泡（助手消息），则直接使用
-            if (lv_obj_get_child_cnt(obj) > 0) {
-                // 可能是容器，检查它是否为用户或系统消息容器
-                // 用户和系统消息容器是透明的
-                lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-                if (bg_opa == LV_OPA_TRANSP) {
-                    // 这是用户或系统消息的容器
-                    bubble = lv_obj_get_child(obj, 0);
-                } else {
-                    // 这可能是助手消息的气泡自身
-                    bubble = obj;
-                }
-            } else {
-                // 没有子元素，可能是其他UI元素，跳过
-                continue;
-            }
-            
-            if (bubble == nullptr) continue;
-            
-            // 使用保存的用户数据来识别气泡类型
-            void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-            if (bubble_type_ptr != nullptr) {
-                const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-                
-                // 根据气泡类型应用正确的颜色
-                if (strcmp(bubble_type, "user") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (strcmp(bubble_type, "assistant") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0); 
-                } else if (strcmp(bubble_type, "system") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                } else if (strcmp(bubble_type, "image") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 根据气泡类型设置文本颜色
-                        if (strcmp(bubble_type, "system") == 0) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
-            } else {
-                // 如果没有标记，回退到之前的逻辑（颜色比较）
-                // ...保留原有的回退逻辑...
-                lv_color_t bg_color = lv_obj_get_style_bg_color(bubble, 0);
-            
-                // 改进bubble类型检测逻辑，不仅使用颜色比较
-                bool is_user_bubble = false;
-                bool is_assistant_bubble = false;
-                bool is_system_bubble = false;
-            
-                // 检查用户bubble
-                if (lv_color_eq(bg_color, DARK_USER_BUBBLE_COLOR) || 
-                    lv_color_eq(bg_color, LIGHT_USER_BUBBLE_COLOR) ||
-                    lv_color_eq(bg_color, current_theme_.user_bubble)) {
-                    is_user_bubble = true;
-                }
-                // 检查系统bubble
-                else if (lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                         lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR) ||
-                         lv_color_eq(bg_color, current_theme_.system_bubble)) {
-                    is_system_bubble = true;
-                }
-                // 剩余的都当作助手bubble处理
-                else {
-                    is_assistant_bubble = true;
-                }
-            
-                // 根据bubble类型应用正确的颜色
-                if (is_user_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (is_assistant_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0);
-                } else if (is_system_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 回退到颜色检测逻辑
-                        if (lv_color_eq(bg_color, current_theme_.system_bubble) ||
-                            lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                            lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR)) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
-            }
-        }
-#else
-        // Simple UI mode - just update the main chat message
-        if (chat_message_label_ != nullptr) {
-            lv_obj_set_style_text_color(chat_message_label_, current_theme_.text, 0);
-        }
-        
-        if (emotion_label_ != nullptr) {
-            lv_obj_set_style_text_color(emotion_label_, current_theme_.text, 0);
-        }
-#endif
-    }
-    
-    // Update low battery popup
-    if (low_battery_popup_ != nullptr) {
-        lv_obj_set_style_bg_color(low_battery_popup_, current_theme_.low_battery, 0);
+
+    if (theme_styles_ready_) {
+        int64_t start_time = esp_timer_get_time();
+        UpdateThemeStyles();
+        // 一次遍历刷新所有使用主题样式的对象，不论聊天记录有多少条
+        lv_obj_report_style_change(nullptr);
+        ESP_LOGI(TAG, "Theme %s applied in %d us, %u chat objects", theme_name.c_str(),
+            (int)(esp_timer_get_time() - start_time), (unsigned)(content_ != nullptr ? lv_obj_get_child_count(content_) : 0));
     }
 
     // No errors occurred. Save theme to settings
@@ -2,12 +2,18 @@
 #define LCD_DISPLAY_H
 
 #include "display.h"
+#include "glyph_cache.h"
+#if CONFIG_USE_FONT_ASSETS
+#include "asset_font.h"
+#endif
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 #include <font_emoji.h>
 
 #include <atomic>
+#include <vector>
+#include <memory>
 
 // Theme color structure
 struct ThemeColors {
@@ -34,11 +40,76 @@ protected:
     lv_obj_t* container_ = nullptr;
     lv_obj_t* side_bar_ = nullptr;
     lv_obj_t* preview_image_ = nullptr;
+    // 缩小后的预览图，缓冲区在多次预览之间复用
+    lv_img_dsc_t preview_copy_ = {};
+    uint8_t* preview_buffer_ = nullptr;
+    size_t preview_buffer_size_ = 0;
 
     DisplayFonts fonts_;
     ThemeColors current_theme_;
+    // 主题样式由同类对象共享，切换主题时只需更新这些样式
+    struct ThemeStyles {
+        lv_style_t background;  // Screen, container and status bar
+        lv_style_t chat_background;
+        lv_style_t user_bubble;
+        lv_style_t assistant_bubble;
+        lv_style_t system_bubble;
+        lv_style_t low_battery;
+    };
+    ThemeStyles theme_styles_;
+    bool theme_styles_ready_ = false;
+    std::unique_ptr<GlyphCache> text_glyph_cache_;  // fonts_.text_font points to its font
+#if CONFIG_USE_FONT_ASSETS
+    std::unique_ptr<AssetFont> asset_font_;
+#endif
+
+    // 渲染统计，只在 LVGL 任务中访问
+    struct RenderStats {
+        uint32_t frames = 0;
+        int64_t period_start = 0;
+        int64_t render_start = 0;
+        int64_t render_us = 0;
+        int64_t flush_wait_start = 0;
+        int64_t flush_wait_us = 0;
+        int64_t flush_wait_max_us = 0;
+        int64_t invalidated_px = 0;
+    };
+    RenderStats render_stats_;
+    // 上一个统计窗口的结果
+    struct RenderSnapshot {
+        uint32_t windows = 0;
+        int fps_x10 = 0;
+        int render_avg_us = 0;
+        int flush_wait_avg_us = 0;
+        int flush_wait_max_us = 0;
+        int invalidated_px_per_s = 0;
+    };
+    RenderSnapshot render_snapshot_;
+    lv_obj_t* perf_hud_ = nullptr;
+
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 可回收的消息气泡，数量达到上限后复用最早的一条
+    struct MessageSlot {
+        lv_obj_t* row;
+        lv_obj_t* bubble;
+        lv_obj_t* label;
+    };
+    std::vector<MessageSlot> message_slots_;
+    uint32_t message_count_ = 0;
+    int64_t message_time_total_ = 0;
+    int64_t message_time_max_ = 0;
+
+    MessageSlot* AcquireMessageSlot();
+    void RemoveOldestMessage();
+#endif
 
     void SetupUI();
+    void InitThemeStyles();
+    void UpdateThemeStyles();
+    lv_style_t* GetBubbleStyle(const char* bubble_type);
+    void InstallRenderStats();
+    void UpdateRenderSnapshot();
+    bool CopyScaledPreview(const lv_img_dsc_t* img_dsc, int max_width, int max_height);
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -57,6 +128,8 @@ public:
 
     // Add theme switching function
     virtual void SetTheme(const std::string& theme_name) override;
+    virtual void SetPerfHudVisible(bool visible) override;
+    virtual std::string GetPerfStatsJson() override;
 };
 
 // RGB LCD显示器
@@ -87,6 +160,7 @@ public:
 };
 
 // QSPI LCD显示器
+// 以下两个类只有声明，没有开发板使用，实现时需要和其他构造函数一样调用 InstallRenderStats
 class QspiLcdDisplay : public LcdDisplay {
 public:
     QspiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
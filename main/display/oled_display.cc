@@ -4,6 +4,7 @@
 
 #include <string>
 #include <algorithm>
+#include <cstring>
 
 #include <esp_log.h>
 #include <esp_err.h>
@@ -50,12 +51,19 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
         },
     };
 
+    // Clear the panel so that the page buffer matches the panel memory
+    page_buffer_.assign(width_ * height_ / 8, 0);
+    column_buffer_.resize(width_);
+    esp_lcd_panel_draw_bitmap(panel_, 0, 0, width_, height_, page_buffer_.data());
+
     display_ = lvgl_port_add_disp(&display_cfg);
     if (display_ == nullptr) {
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
 
+    InstallPageFlush();
+
     if (height_ == 64) {
         SetupUI_128x64();
     } else {
@@ -86,6 +94,76 @@ OledDisplay::~OledDisplay() {
     lvgl_port_deinit();
 }
 
+void OledDisplay::InstallPageFlush() {
+    DisplayLockGuard lock(this);
+    // The port already rounds the invalidated areas to whole pages for monochrome displays.
+    // Each flush sends several bitmaps or none, so the flush is finished here instead of
+    // in the port's color transfer done callback, which would report it once per bitmap.
+    const esp_lcd_panel_io_callbacks_t callbacks = {
+        .on_color_trans_done = nullptr,
+    };
+    esp_lcd_panel_io_register_event_callbacks(panel_io_, &callbacks, nullptr);
+    lv_display_set_user_data(display_, this);
+    lv_display_set_flush_cb(display_, [](lv_display_t* disp, const lv_area_t* area, uint8_t* px_map) {
+        auto display = static_cast<OledDisplay*>(lv_display_get_user_data(disp));
+        display->FlushPages(area, px_map);
+        lv_display_flush_ready(disp);
+    });
+}
+
+// Converts the rendered I1 area to the page layout and sends only the columns that differ from the panel
+void OledDisplay::FlushPages(const lv_area_t* area, const uint8_t* px_map) {
+    px_map += 8;  // Skip the I1 palette
+    int32_t area_width = lv_area_get_width(area);
+    uint32_t stride = lv_draw_buf_width_to_stride(area_width, LV_COLOR_FORMAT_I1);
+    uint8_t* columns = column_buffer_.data();
+
+    flush_count_++;
+    for (int32_t page_y = area->y1; page_y <= area->y2; page_y += 8) {
+        // Pack 8 rows into one byte per column, a cleared pixel in I1 is a lit OLED pixel
+        memset(columns, 0, area_width);
+        for (int bit = 0; bit < 8 && page_y + bit <= area->y2; bit++) {
+            const uint8_t* row = px_map + (page_y + bit - area->y1) * stride;
+            for (int32_t x = 0; x < area_width; x++) {
+                if ((row[x >> 3] & (0x80 >> (x & 7))) == 0) {
+                    columns[x] |= 1 << bit;
+                }
+            }
+        }
+
+        uint8_t* page = page_buffer_.data() + (page_y / 8) * width_ + area->x1;
+        int32_t first = 0;
+        while (first < area_width && columns[first] == page[first]) {
+            first++;
+        }
+        if (first == area_width) {
+            flush_bytes_skipped_ += area_width;
+            continue;
+        }
+        int32_t last = area_width - 1;
+        while (columns[last] == page[last]) {
+            last--;
+        }
+        memcpy(page + first, columns + first, last - first + 1);
+        esp_lcd_panel_draw_bitmap(panel_, area->x1 + first, page_y, area->x1 + last + 1, page_y + 8, page + first);
+        flush_bytes_sent_ += last - first + 1;
+        flush_bytes_skipped_ += area_width - (last - first + 1);
+    }
+}
+
+std::string OledDisplay::GetPerfStatsJson() {
+    auto json = Display::GetPerfStatsJson();
+    char buffer[128];
+    {
+        DisplayLockGuard lock(this);
+        snprintf(buffer, sizeof(buffer), ",\"oled\":{\"flushes\":%u,\"bytes_sent\":%u,\"bytes_skipped\":%u}}",
+            (unsigned)flush_count_, (unsigned)flush_bytes_sent_, (unsigned)flush_bytes_skipped_);
+    }
+    json.pop_back();
+    json += buffer;
+    return json;
+}
+
 bool OledDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
@@ -6,6 +6,8 @@
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 
+#include <vector>
+
 class OledDisplay : public Display {
 private:
     esp_lcd_panel_io_handle_t panel_io_ = nullptr;
@@ -20,6 +22,16 @@ private:
 
     DisplayFonts fonts_;
 
+    // 屏幕当前内容的页格式副本 (SSD1306: 每页 8 行，每个字节是一列)，只发送变化的列
+    std::vector<uint8_t> page_buffer_;
+    std::vector<uint8_t> column_buffer_;
+    uint32_t flush_count_ = 0;
+    uint32_t flush_bytes_sent_ = 0;
+    uint32_t flush_bytes_skipped_ = 0;
+
+    void InstallPageFlush();
+    void FlushPages(const lv_area_t* area, const uint8_t* px_map);
+
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -32,6 +44,7 @@ public:
     ~OledDisplay();
 
     virtual void SetChatMessage(const char* role, const char* content) override;
+    virtual std::string GetPerfStatsJson() override;
 };
 
 #endif // OLED_DISPLAY_H
@@ -0,0 +1,139 @@
+#include "ppa_image_ops.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_cache.h>
+
+#define TAG "PpaImageOps"
+
+// PPA 缩放系数的小数部分为 4 位，即 1/16 的整数倍
+#define PPA_SCALE_STEPS 16
+#define JPEG_DECODE_TIMEOUT_MS 100
+
+PpaImageOps::PpaImageOps() {
+    esp_cache_get_alignment(MALLOC_CAP_SPIRAM, &alignment_);
+
+    ppa_client_config_t client_config = {
+        .oper_type = PPA_OPERATION_SRM,
+        .max_pending_trans_num = 1,
+    };
+    if (ppa_register_client(&client_config, &srm_client_) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register PPA SRM client, using software scaling");
+        srm_client_ = nullptr;
+    }
+
+#if CONFIG_SOC_JPEG_DECODE_SUPPORTED
+    jpeg_decode_engine_cfg_t engine_config = {
+        .intr_priority = 0,
+        .timeout_ms = JPEG_DECODE_TIMEOUT_MS,
+    };
+    if (jpeg_new_decoder_engine(&engine_config, &jpeg_decoder_) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create JPEG decoder, using software decoding");
+        jpeg_decoder_ = nullptr;
+    }
+#endif
+    ESP_LOGI(TAG, "Image ops on PPA, buffer alignment %u", (unsigned)alignment_);
+}
+
+PpaImageOps::~PpaImageOps() {
+    if (srm_client_ != nullptr) {
+        ppa_unregister_client(srm_client_);
+    }
+#if CONFIG_SOC_JPEG_DECODE_SUPPORTED
+    if (jpeg_decoder_ != nullptr) {
+        jpeg_del_decoder_engine(jpeg_decoder_);
+    }
+#endif
+}
+
+// The DMA writes whole cache lines, so both the address and the size are aligned
+uint8_t* PpaImageOps::AllocBuffer(size_t size) {
+    auto buffer = (uint8_t*)heap_caps_aligned_calloc(alignment_, 1, AlignSize(size), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buffer == nullptr) {
+        return SoftwareImageOps::AllocBuffer(size);
+    }
+    return buffer;
+}
+
+bool PpaImageOps::DoSrm(const uint8_t* src, int src_w, int src_h, uint8_t* dst, int dst_w, int dst_h,
+    float scale_x, float scale_y, bool byte_swap) {
+    if (srm_client_ == nullptr || !IsAligned(dst)) {
+        return false;
+    }
+    ppa_srm_oper_config_t config = {};
+    config.in.buffer = src;
+    config.in.pic_w = src_w;
+    config.in.pic_h = src_h;
+    config.in.block_w = src_w;
+    config.in.block_h = src_h;
+    config.in.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
+    config.out.buffer = dst;
+    config.out.buffer_size = AlignSize(dst_w * dst_h * 2);
+    config.out.pic_w = dst_w;
+    config.out.pic_h = dst_h;
+    config.out.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
+    config.rotation_angle = PPA_SRM_ROTATION_ANGLE_0;
+    config.scale_x = scale_x;
+    config.scale_y = scale_y;
+    config.byte_swap = byte_swap;
+    config.mode = PPA_TRANS_MODE_BLOCKING;
+    esp_err_t err = ppa_do_scale_rotate_mirror(srm_client_, &config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "PPA operation failed: %s, using software", esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+bool PpaImageOps::ScaleRgb565(const lv_img_dsc_t* src, uint8_t* dst, int* width, int* height) {
+    int src_w = src->header.w;
+    int src_h = src->header.h;
+    int steps_x = *width * PPA_SCALE_STEPS / src_w;
+    int steps_y = *height * PPA_SCALE_STEPS / src_h;
+    bool packed = src->header.stride == 0 || src->header.stride == src_w * 2;
+    if (packed && steps_x > 0 && steps_y > 0 && steps_x <= PPA_SCALE_STEPS && steps_y <= PPA_SCALE_STEPS) {
+        // Round the scale down to what the PPA can do, the image may come out a few pixels smaller
+        int dst_w = src_w * steps_x / PPA_SCALE_STEPS;
+        int dst_h = src_h * steps_y / PPA_SCALE_STEPS;
+        if (DoSrm(src->data, src_w, src_h, dst, dst_w, dst_h, (float)steps_x / PPA_SCALE_STEPS,
+                (float)steps_y / PPA_SCALE_STEPS, false)) {
+            *width = dst_w;
+            *height = dst_h;
+            return true;
+        }
+    }
+    return SoftwareImageOps::ScaleRgb565(src, dst, width, height);
+}
+
+bool PpaImageOps::SwapRgb565(const uint8_t* src, uint8_t* dst, int width, int height) {
+    if (src != dst && DoSrm(src, width, height, dst, width, height, 1.0f, 1.0f, true)) {
+        return true;
+    }
+    return SoftwareImageOps::SwapRgb565(src, dst, width, height);
+}
+
+bool PpaImageOps::DecodeJpegRgb565(const uint8_t* jpeg, size_t jpeg_size, uint8_t* dst, size_t dst_size, int* width, int* height) {
+#if CONFIG_SOC_JPEG_DECODE_SUPPORTED
+    jpeg_decode_picture_info_t info;
+    if (jpeg_decoder_ != nullptr && IsAligned(dst) && jpeg_decoder_get_info(jpeg, jpeg_size, &info) == ESP_OK) {
+        // The decoder writes whole 16x16 blocks, other sizes would not match the output stride
+        bool block_aligned = info.width % 16 == 0 && info.height % 16 == 0;
+        if (block_aligned && info.width * info.height * 2 <= dst_size) {
+            jpeg_decode_cfg_t decode_config = {
+                .output_format = JPEG_DECODE_OUT_FORMAT_RGB565,
+                .rgb_order = JPEG_DEC_RGB_ELEMENT_ORDER_BGR,
+                .conv_std = JPEG_YUV_RGB_CONV_STD_BT601,
+            };
+            uint32_t out_size = 0;
+            esp_err_t err = jpeg_decoder_process(jpeg_decoder_, &decode_config, jpeg, jpeg_size, dst, dst_size, &out_size);
+            if (err == ESP_OK) {
+                *width = info.width;
+                *height = info.height;
+                return true;
+            }
+            ESP_LOGW(TAG, "JPEG decode failed: %s, using software", esp_err_to_name(err));
+        }
+    }
+#endif
+    return SoftwareImageOps::DecodeJpegRgb565(jpeg, jpeg_size, dst, dst_size, width, height);
+}
@@ -0,0 +1,37 @@
+#ifndef PPA_IMAGE_OPS_H
+#define PPA_IMAGE_OPS_H
+
+#include "software_image_ops.h"
+
+#include <driver/ppa.h>
+#if CONFIG_SOC_JPEG_DECODE_SUPPORTED
+#include <driver/jpeg_decode.h>
+#endif
+
+// ESP32-P4 的 PPA 缩放 / 字节交换和硬件 JPEG 解码，不支持的情况退回软件实现
+class PpaImageOps : public SoftwareImageOps {
+public:
+    PpaImageOps();
+    ~PpaImageOps();
+
+    virtual const char* name() const override { return "ppa"; }
+    virtual uint8_t* AllocBuffer(size_t size) override;
+
+protected:
+    virtual bool ScaleRgb565(const lv_img_dsc_t* src, uint8_t* dst, int* width, int* height) override;
+    virtual bool SwapRgb565(const uint8_t* src, uint8_t* dst, int width, int height) override;
+    virtual bool DecodeJpegRgb565(const uint8_t* jpeg, size_t jpeg_size, uint8_t* dst, size_t dst_size, int* width, int* height) override;
+
+private:
+    ppa_client_handle_t srm_client_ = nullptr;
+#if CONFIG_SOC_JPEG_DECODE_SUPPORTED
+    jpeg_decoder_handle_t jpeg_decoder_ = nullptr;
+#endif
+    size_t alignment_ = 64;
+
+    bool IsAligned(const void* buffer) const { return ((uintptr_t)buffer % alignment_) == 0; }
+    size_t AlignSize(size_t size) const { return (size + alignment_ - 1) / alignment_ * alignment_; }
+    bool DoSrm(const uint8_t* src, int src_w, int src_h, uint8_t* dst, int dst_w, int dst_h, float scale_x, float scale_y, bool byte_swap);
+};
+
+#endif // PPA_IMAGE_OPS_H
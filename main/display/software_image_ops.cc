@@ -0,0 +1,98 @@
+#include "software_image_ops.h"
+
+#include <esp_log.h>
+#include <img_converters.h>
+#include <algorithm>
+
+#define TAG "SoftwareImageOps"
+
+// Reads the frame size from the first SOF marker
+static bool GetJpegSize(const uint8_t* jpeg, size_t size, int* width, int* height) {
+    if (size < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        return false;
+    }
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (jpeg[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = jpeg[pos + 1];
+        if (marker == 0xFF) {
+            pos++;  // Fill byte
+            continue;
+        }
+        size_t length = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+        bool is_sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (is_sof) {
+            if (pos + 9 > size) {
+                return false;
+            }
+            *height = (jpeg[pos + 5] << 8) | jpeg[pos + 6];
+            *width = (jpeg[pos + 7] << 8) | jpeg[pos + 8];
+            return *width > 0 && *height > 0;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+// 区域平均缩小，每个源像素只读取一次
+bool SoftwareImageOps::ScaleRgb565(const lv_img_dsc_t* src, uint8_t* dst, int* width, int* height) {
+    int src_w = src->header.w;
+    int src_h = src->header.h;
+    int dst_w = *width;
+    int dst_h = *height;
+    if (src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0) {
+        return false;
+    }
+    int src_stride = src->header.stride != 0 ? src->header.stride / 2 : src_w;
+    auto pixels = reinterpret_cast<const uint16_t*>(src->data);
+    auto out = reinterpret_cast<uint16_t*>(dst);
+    for (int dy = 0; dy < dst_h; dy++) {
+        int y0 = dy * src_h / dst_h;
+        int y1 = std::max(y0 + 1, (dy + 1) * src_h / dst_h);
+        for (int dx = 0; dx < dst_w; dx++) {
+            int x0 = dx * src_w / dst_w;
+            int x1 = std::max(x0 + 1, (dx + 1) * src_w / dst_w);
+            uint32_t r = 0, g = 0, b = 0;
+            for (int y = y0; y < y1; y++) {
+                const uint16_t* row = pixels + y * src_stride;
+                for (int x = x0; x < x1; x++) {
+                    uint16_t pixel = row[x];
+                    r += pixel >> 11;
+                    g += (pixel >> 5) & 0x3F;
+                    b += pixel & 0x1F;
+                }
+            }
+            uint32_t count = (y1 - y0) * (x1 - x0);
+            *out++ = ((r / count) << 11) | ((g / count) << 5) | (b / count);
+        }
+    }
+    return true;
+}
+
+bool SoftwareImageOps::SwapRgb565(const uint8_t* src, uint8_t* dst, int width, int height) {
+    auto in = reinterpret_cast<const uint16_t*>(src);
+    auto out = reinterpret_cast<uint16_t*>(dst);
+    size_t pixel_count = width * height;
+    for (size_t i = 0; i < pixel_count; i++) {
+        out[i] = __builtin_bswap16(in[i]);
+    }
+    return true;
+}
+
+bool SoftwareImageOps::DecodeJpegRgb565(const uint8_t* jpeg, size_t jpeg_size, uint8_t* dst, size_t dst_size, int* width, int* height) {
+    if (!GetJpegSize(jpeg, jpeg_size, width, height)) {
+        ESP_LOGE(TAG, "Invalid JPEG header");
+        return false;
+    }
+    if ((size_t)*width * *height * 2 > dst_size) {
+        ESP_LOGE(TAG, "JPEG %dx%d does not fit in %u bytes", *width, *height, (unsigned)dst_size);
+        return false;
+    }
+    if (!jpg2rgb565(jpeg, jpeg_size, dst, JPG_SCALE_NONE)) {
+        return false;
+    }
+    // jpg2rgb565 writes big-endian pixels
+    return SwapRgb565(dst, dst, *width, *height);
+}
@@ -0,0 +1,17 @@
+#ifndef SOFTWARE_IMAGE_OPS_H
+#define SOFTWARE_IMAGE_OPS_H
+
+#include "image_ops.h"
+
+// 软件实现，所有芯片可用，也是硬件后端的回退路径
+class SoftwareImageOps : public ImageOps {
+public:
+    virtual const char* name() const override { return "software"; }
+
+protected:
+    virtual bool ScaleRgb565(const lv_img_dsc_t* src, uint8_t* dst, int* width, int* height) override;
+    virtual bool SwapRgb565(const uint8_t* src, uint8_t* dst, int width, int height) override;
+    virtual bool DecodeJpegRgb565(const uint8_t* jpeg, size_t jpeg_size, uint8_t* dst, size_t dst_size, int* width, int* height) override;
+};
+
+#endif // SOFTWARE_IMAGE_OPS_H
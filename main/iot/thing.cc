@@ -1,4 +1,5 @@
 #include "thing.h"
+#include "thing_manager.h"
 #include "application.h"
 
 #include <esp_log.h>
@@ -44,14 +45,26 @@ std::string Thing::GetDescriptorJson() {
     return json_str;
 }
 
-std::string Thing::GetStateJson() {
+std::string Thing::GetStateJson(bool delta) {
+    auto state = properties_.GetStateJson(delta);
+    if (state.empty()) {
+        return "";
+    }
     std::string json_str = "{";
     json_str += "\"name\":\"" + name_ + "\",";
-    json_str += "\"state\":" + properties_.GetStateJson();
+    json_str += "\"state\":" + state;
     json_str += "}";
     return json_str;
 }
 
+void Thing::NotifyPropertyChanged(const std::string& name) {
+    // The properties are only touched on the main loop, the update is requested after the flag is set
+    Application::GetInstance().Schedule([this, name]() {
+        properties_.MarkDirty(name);
+        ThingManager::GetInstance().NotifyStatesChanged();
+    });
+}
+
 void Thing::Invoke(const cJSON* command) {
     auto method_name = cJSON_GetObjectItem(command, "method");
     auto input_params = cJSON_GetObjectItem(command, "parameters");
@@ -81,6 +94,8 @@ void Thing::Invoke(const cJSON* command) {
 
         Application::GetInstance().Schedule([&method]() {
             method.Invoke();
+            // The method usually changes the state, report it now
+            ThingManager::GetInstance().NotifyStatesChanged();
         });
     } catch (const std::runtime_error& e) {
         ESP_LOGE(TAG, "Method not found: %s", method_name->valuestring);
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <functional>
 #include <vector>
 #include <stdexcept>
@@ -24,6 +25,9 @@ private:
     std::function<bool()> boolean_getter_;
     std::function<int()> number_getter_;
     std::function<std::string()> string_getter_;
+    // 上次上报的状态，只有变化或被标记为脏的属性才会再次上报
+    std::string last_state_;
+    bool dirty_ = true;
 
 public:
     Property(const std::string& name, const std::string& description, std::function<bool()> getter) :
@@ -65,6 +69,20 @@ public:
         }
         return "null";
     }
+
+    void MarkDirty() { dirty_ = true; }
+
+    // Read the state and remember it as reported, returns false if it is unchanged and not dirty
+    bool UpdateState() {
+        auto state = GetStateJson();
+        if (!dirty_ && state == last_state_) {
+            return false;
+        }
+        last_state_ = std::move(state);
+        dirty_ = false;
+        return true;
+    }
+    const std::string& last_state() const { return last_state_; }
 };
 
 class PropertyList {
@@ -106,13 +124,29 @@ public:
         return json_str;
     }
 
-    std::string GetStateJson() {
+    void MarkDirty(const std::string& name) {
+        for (auto& property : properties_) {
+            if (property.name() == name) {
+                property.MarkDirty();
+                return;
+            }
+        }
+    }
+
+    // If delta is true, only the properties changed since the last report are serialized,
+    // and an empty string is returned when nothing changed
+    std::string GetStateJson(bool delta = false) {
         std::string json_str = "{";
         for (auto& property : properties_) {
-            json_str += "\"" + property.name() + "\":" + property.GetStateJson() + ",";
+            if (!property.UpdateState() && delta) {
+                continue;
+            }
+            json_str += "\"" + property.name() + "\":" + property.last_state() + ",";
         }
         if (json_str.back() == ',') {
             json_str.pop_back();
+        } else if (delta) {
+            return "";
         }
         json_str += "}";
         return json_str;
@@ -164,21 +198,26 @@ public:
 class ParameterList {
 private:
     std::vector<Parameter> parameters_;
+    std::unordered_map<std::string, size_t> index_;  // name -> position in parameters_
 
 public:
     ParameterList() = default;
-    ParameterList(const std::vector<Parameter>& parameters) : parameters_(parameters) {}
+    ParameterList(const std::vector<Parameter>& parameters) : parameters_(parameters) {
+        for (size_t i = 0; i < parameters_.size(); i++) {
+            index_[parameters_[i].name()] = i;
+        }
+    }
     void AddParameter(const Parameter& parameter) {
+        index_[parameter.name()] = parameters_.size();
         parameters_.push_back(parameter);
     }
 
     const Parameter& operator[](const std::string& name) const {
-        for (auto& parameter : parameters_) {
-            if (parameter.name() == name) {
-                return parameter;
-            }
+        auto it = index_.find(name);
+        if (it == index_.end()) {
+            throw std::runtime_error("Parameter not found: " + name);
         }
-        throw std::runtime_error("Parameter not found: " + name);
+        return parameters_[it->second];
     }
 
     // iterator
@@ -229,22 +268,27 @@ public:
 class MethodList {
 private:
     std::vector<Method> methods_;
+    std::unordered_map<std::string, size_t> index_;  // name -> position in methods_
 
 public:
     MethodList() = default;
-    MethodList(const std::vector<Method>& methods) : methods_(methods) {}
+    MethodList(const std::vector<Method>& methods) : methods_(methods) {
+        for (size_t i = 0; i < methods_.size(); i++) {
+            index_[methods_[i].name()] = i;
+        }
+    }
 
     void AddMethod(const std::string& name, const std::string& description, const ParameterList& parameters, std::function<void(const ParameterList&)> callback) {
+        index_[name] = methods_.size();
         methods_.push_back(Method(name, description, parameters, callback));
     }
 
     Method& operator[](const std::string& name) {
-        for (auto& method : methods_) {
-            if (method.name() == name) {
-                return method;
-            }
+        auto it = index_.find(name);
+        if (it == index_.end()) {
+            throw std::runtime_error("Method not found: " + name);
         }
-        throw std::runtime_error("Method not found: " + name);
+        return methods_[it->second];
     }
 
     std::string GetDescriptorJson() {
@@ -267,9 +311,13 @@ public:
     virtual ~Thing() = default;
 
     virtual std::string GetDescriptorJson();
-    virtual std::string GetStateJson();
+    virtual std::string GetStateJson(bool delta = false);
     virtual void Invoke(const cJSON* command);
 
+    // Called by the owner when a property changes outside of a method call, from any task,
+    // the change is pushed to the server without waiting for the next update
+    void NotifyPropertyChanged(const std::string& name);
+
     const std::string& name() const { return name_; }
     const std::string& description() const { return description_; }
 
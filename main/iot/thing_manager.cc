@@ -1,6 +1,9 @@
 #include "thing_manager.h"
 
+#include "application.h"
+
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #define TAG "ThingManager"
 
@@ -8,12 +11,15 @@ namespace iot {
 
 void ThingManager::AddThing(Thing* thing) {
     things_.push_back(thing);
+    things_by_name_[thing->name()] = thing;
+    // The methods and properties are fixed after construction
+    descriptors_.push_back(thing->GetDescriptorJson());
 }
 
 std::string ThingManager::GetDescriptorsJson() {
     std::string json_str = "[";
-    for (auto& thing : things_) {
-        json_str += thing->GetDescriptorJson() + ",";
+    for (auto& descriptor : descriptors_) {
+        json_str += descriptor + ",";
     }
     if (json_str.back() == ',') {
         json_str.pop_back();
@@ -23,41 +29,63 @@ std::string ThingManager::GetDescriptorsJson() {
 }
 
 bool ThingManager::GetStatesJson(std::string& json, bool delta) {
-    if (!delta) {
-        last_states_.clear();
-    }
+    int64_t start_time = esp_timer_get_time();
     bool changed = false;
     json = "[";
-    // 枚举thing，获取每个thing的state，如果发生变化，则更新，保存到last_states_
-    // 如果delta为true，则只返回变化的部分
+    // 枚举thing，每个属性记录上次上报的状态
+    // 如果delta为true，则只返回变化的属性，没有变化的thing不返回
     for (auto& thing : things_) {
-        std::string state = thing->GetStateJson();
-        if (delta) {
-            // 如果delta为true，则只返回变化的部分
-            auto it = last_states_.find(thing->name());
-            if (it != last_states_.end() && it->second == state) {
-                continue;
-            }
-            changed = true;
-            last_states_[thing->name()] = state;
+        std::string state = thing->GetStateJson(delta);
+        if (state.empty()) {
+            continue;
         }
+        changed = true;
         json += state + ",";
     }
     if (json.back() == ',') {
         json.pop_back();
     }
     json += "]";
+    if (changed) {
+        ESP_LOGI(TAG, "States serialized (%u bytes) in %d us", (unsigned)json.size(), (int)(esp_timer_get_time() - start_time));
+    }
     return changed;
 }
 
+void ThingManager::NotifyStatesChanged() {
+    if (update_pending_.exchange(true)) {
+        return;
+    }
+    Application::GetInstance().Schedule([this]() {
+        update_pending_ = false;
+        Application::GetInstance().UpdateIotStates();
+    });
+}
+
+void ThingManager::NotifyPropertyChanged(const std::string& thing_name, const std::string& property_name) {
+#if CONFIG_IOT_PROTOCOL_XIAOZHI
+    // Things are added on the main loop, look it up there
+    Application::GetInstance().Schedule([this, thing_name, property_name]() {
+        auto it = things_by_name_.find(thing_name);
+        if (it != things_by_name_.end()) {
+            it->second->NotifyPropertyChanged(property_name);
+        }
+    });
+#endif
+}
+
 void ThingManager::Invoke(const cJSON* command) {
     auto name = cJSON_GetObjectItem(command, "name");
-    for (auto& thing : things_) {
-        if (thing->name() == name->valuestring) {
-            thing->Invoke(command);
-            return;
-        }
+    if (!cJSON_IsString(name)) {
+        ESP_LOGE(TAG, "Invalid thing name");
+        return;
+    }
+    auto it = things_by_name_.find(name->valuestring);
+    if (it == things_by_name_.end()) {
+        ESP_LOGE(TAG, "Thing not found: %s", name->valuestring);
+        return;
     }
+    it->second->Invoke(command);
 }
 
 } // namespace iot
@@ -10,6 +10,8 @@
 #include <memory>
 #include <functional>
 #include <map>
+#include <unordered_map>
+#include <atomic>
 
 namespace iot {
 
@@ -25,15 +27,24 @@ public:
     void AddThing(Thing* thing);
 
     std::string GetDescriptorsJson();
+    // Each Thing's descriptor, serialized once when the Thing is added
+    const std::vector<std::string>& GetDescriptors() const { return descriptors_; }
+    // Updates the reported state of each property, only call it on the main loop
     bool GetStatesJson(std::string& json, bool delta = false);
     void Invoke(const cJSON* command);
+    // Push the changed states from the main loop, repeated notifications are coalesced
+    void NotifyStatesChanged();
+    // For property owners that do not hold the Thing, e.g. the audio codec and the backlight
+    void NotifyPropertyChanged(const std::string& thing_name, const std::string& property_name);
 
 private:
     ThingManager() = default;
     ~ThingManager() = default;
 
     std::vector<Thing*> things_;
-    std::map<std::string, std::string> last_states_;
+    std::unordered_map<std::string, Thing*> things_by_name_;
+    std::vector<std::string> descriptors_;
+    std::atomic<bool> update_pending_{false};
 };
 
 
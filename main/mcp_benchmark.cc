@@ -0,0 +1,161 @@
+/*
+ * MCP Server Benchmark
+ *
+ * 在设备上重放初始化、工具列表分页、工具调用参数绑定以及格式错误的 JSON-RPC 消息，
+ * 并对这些消息做随机变异，输出每类消息的耗时与内存占用。消息经过 ParseMessage 完整处理，
+ * 回复只计入字节数，不会发送到服务器。
+ */
+
+#include "mcp_server.h"
+#include <esp_log.h>
+#include <algorithm>
+#include <esp_random.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define TAG "McpBenchmark"
+
+#define BENCHMARK_REPEAT 20
+#define FUZZ_ITERATIONS 1000
+
+// A tools/call that runs a tool, the other calls are rejected before any tool runs
+#define BENCHMARK_TOOL "self.get_device_status"
+
+void McpServer::RunBenchmark() {
+    struct BenchmarkCase {
+        std::string name;
+        std::string message;
+    };
+    std::vector<BenchmarkCase> cases = {
+        {"initialize", "{\"jsonrpc\":\"2.0\",\"method\":\"initialize\",\"params\":{\"capabilities\":{}},\"id\":1}"},
+        {"tools/list invalid cursor", "{\"jsonrpc\":\"2.0\",\"method\":\"tools/list\",\"params\":{\"cursor\":\"no.such.tool\"},\"id\":3}"},
+        {"tools/call", "{\"jsonrpc\":\"2.0\",\"method\":\"tools/call\",\"params\":{\"name\":\"" BENCHMARK_TOOL "\",\"arguments\":{}},\"id\":4}"},
+        {"tools/call unknown tool", "{\"jsonrpc\":\"2.0\",\"method\":\"tools/call\",\"params\":{\"name\":\"self.no_such_tool\",\"arguments\":{}},\"id\":5}"},
+        {"tools/call invalid arguments", "{\"jsonrpc\":\"2.0\",\"method\":\"tools/call\",\"params\":{\"name\":\"" BENCHMARK_TOOL "\",\"arguments\":[]},\"id\":6}"},
+        {"notifications/cancelled", "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/cancelled\",\"params\":{\"requestId\":12345}}"},
+        {"batch", "[{\"jsonrpc\":\"2.0\",\"method\":\"initialize\",\"params\":{},\"id\":7},"
+            "{\"jsonrpc\":\"2.0\",\"method\":\"tools/list\",\"params\":{\"cursor\":\"\"},\"id\":8},"
+            "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/initialized\"}]"},
+        {"empty batch", "[]"},
+        {"batch of non-objects", "[1,\"2\",null]"},
+        {"invalid JSON", "{\"jsonrpc\":\"2.0\",\"method\":"},
+        {"wrong version", "{\"jsonrpc\":\"1.0\",\"method\":\"initialize\",\"id\":9}"},
+        {"number version", "{\"jsonrpc\":2,\"method\":\"initialize\",\"id\":10}"},
+        {"missing method", "{\"jsonrpc\":\"2.0\",\"id\":11}"},
+        {"unknown method", "{\"jsonrpc\":\"2.0\",\"method\":\"resources/list\",\"id\":12}"},
+        {"array params", "{\"jsonrpc\":\"2.0\",\"method\":\"tools/list\",\"params\":[],\"id\":13}"},
+        {"string id", "{\"jsonrpc\":\"2.0\",\"method\":\"tools/list\",\"id\":\"14\"}"},
+    };
+
+    // Page through tools/list with the cursors a server would send
+    if (tools_list_dirty_) {
+        BuildToolsListPages();
+    }
+    for (const auto& page : tools_list_pages_) {
+        cases.push_back({"tools/list page " + (page.cursor.empty() ? std::string("0") : page.cursor),
+            "{\"jsonrpc\":\"2.0\",\"method\":\"tools/list\",\"params\":{\"cursor\":\"" + page.cursor + "\"},\"id\":2}"});
+    }
+
+    // Long strings and deep nesting
+    cases.push_back({"long string", "{\"jsonrpc\":\"2.0\",\"method\":\"" + std::string(4096, 'a') + "\",\"id\":15}"});
+    cases.push_back({"deep nesting", "{\"jsonrpc\":\"2.0\",\"method\":\"tools/list\",\"params\":{\"cursor\":" +
+        std::string(64, '[') + std::string(64, ']') + "},\"id\":16}"});
+
+    // Runs one message through ParseMessage, the replies go to the local sink
+    auto dispatch = [this](const std::string& message) -> size_t {
+        size_t sent_before = reply_sink_bytes_;
+        ParseMessage(message);
+        return reply_sink_bytes_ - sent_before;
+    };
+
+    // The error logs of the malformed input would dominate the timing
+    esp_log_level_t mcp_log_level = esp_log_level_get("MCP");
+    esp_log_level_t rule_engine_log_level = esp_log_level_get("RuleEngine");
+    esp_log_level_set("MCP", ESP_LOG_NONE);
+    esp_log_level_set("RuleEngine", ESP_LOG_NONE);
+    reply_sink_enabled_ = true;
+
+    size_t start_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    for (const auto& benchmark_case : cases) {
+        int64_t total_time = 0;
+        int64_t max_time = 0;
+        size_t reply_size = 0;
+        size_t free_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+        for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+            int64_t start_time = esp_timer_get_time();
+            reply_size = dispatch(benchmark_case.message);
+            int64_t elapsed = esp_timer_get_time() - start_time;
+            total_time += elapsed;
+            max_time = std::max(max_time, elapsed);
+        }
+        // Let the tool call workers finish before checking for leaks
+        vTaskDelay(pdMS_TO_TICKS(50));
+        int leaked = (int)free_before - (int)heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+        ESP_LOGI(TAG, "%-32s avg %5d us, max %5d us, reply %5u bytes, heap delta %d bytes", benchmark_case.name.c_str(),
+            (int)(total_time / BENCHMARK_REPEAT), (int)max_time, (unsigned)reply_size, leaked);
+    }
+
+    // Bind every tool's arguments, which covers all the property types without running the tools
+    for (auto tool : tools_) {
+        auto arguments = cJSON_CreateObject();
+        const auto& properties = tool->properties();
+        for (size_t i = 0; i < properties.size(); i++) {
+            const auto& property = properties.at(i);
+            if (property.type() == kPropertyTypeBoolean) {
+                cJSON_AddBoolToObject(arguments, property.name().c_str(), true);
+            } else if (property.type() == kPropertyTypeInteger) {
+                cJSON_AddNumberToObject(arguments, property.name().c_str(), property.has_range() ? property.min_value() : 0);
+            } else {
+                cJSON_AddStringToObject(arguments, property.name().c_str(), "benchmark");
+            }
+        }
+        auto batch = std::make_shared<ReplyBatch>();
+        batch->local = true;
+        int64_t start_time = esp_timer_get_time();
+        for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+            std::vector<PropertyValue> slots;
+            BindArguments(-1, tool, arguments, slots, batch);
+        }
+        ESP_LOGI(TAG, "bind %-27s avg %5d us, %u properties", tool->name().c_str(),
+            (int)((esp_timer_get_time() - start_time) / BENCHMARK_REPEAT), (unsigned)tool->properties().size());
+        cJSON_Delete(arguments);
+        ReleaseBatch(batch);
+    }
+
+    // Mutate the messages at random to find crashes and slow paths
+    static const char kFuzzChars[] = "{}[]\":,0123456789.-eE+truefalsnl\\ \x01\xff";
+    int64_t slowest_time = 0;
+    std::string slowest_input;
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    for (int i = 0; i < FUZZ_ITERATIONS; i++) {
+        std::string input = cases[esp_random() % cases.size()].message;
+        int mutations = 1 + esp_random() % 4;
+        for (int j = 0; j < mutations && !input.empty(); j++) {
+            size_t pos = esp_random() % input.size();
+            char c = kFuzzChars[esp_random() % (sizeof(kFuzzChars) - 1)];
+            switch (esp_random() % 4) {
+                case 0: input[pos] = c; break;
+                case 1: input.insert(pos, 1, c); break;
+                case 2: input.erase(pos, 1); break;
+                default: input.resize(pos); break;
+            }
+        }
+        int64_t start_time = esp_timer_get_time();
+        dispatch(input);
+        int64_t elapsed = esp_timer_get_time() - start_time;
+        if (elapsed > slowest_time) {
+            slowest_time = elapsed;
+            slowest_input = input;
+        }
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));
+    ESP_LOGI(TAG, "fuzz %d inputs, heap delta %d bytes, slowest %d us: %.128s", FUZZ_ITERATIONS,
+        (int)free_before - (int)heap_caps_get_free_size(MALLOC_CAP_DEFAULT), (int)slowest_time, slowest_input.c_str());
+
+    reply_sink_enabled_ = false;
+    esp_log_level_set("MCP", mcp_log_level);
+    esp_log_level_set("RuleEngine", rule_engine_log_level);
+    ESP_LOGI(TAG, "Internal heap low-water mark: %u -> %u bytes", (unsigned)start_min_free,
+        (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+}
@@ -9,6 +9,12 @@
 #include <algorithm>
 #include <cstring>
 #include <esp_pthread.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/base64.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 #include "application.h"
 #include "display.h"
@@ -17,11 +23,37 @@
 #define TAG "MCP"
 
 #define DEFAULT_TOOLCALL_STACK_SIZE 6144
+#define MAX_PAYLOAD_SIZE 8000
+// Room kept in a batch reply for the error entry that reports the dropped replies
+#define BATCH_DROPPED_ERROR_RESERVE 128
+// 截图按块返回，块大小由消息上限减去结果头、文本转义和 JSON-RPC 信封的开销后按 base64 换算
+#define SCREENSHOT_RESULT_OVERHEAD 800
+#define SCREENSHOT_CHUNK_SIZE ((MAX_PAYLOAD_SIZE - SCREENSHOT_RESULT_OVERHEAD) / 4 * 3)
+// jpge 编码时的栈用量没有测过，截图在独立线程上用更大的栈运行
+#define SCREENSHOT_STACK_SIZE 12288
+#define DEFAULT_TOOLCALL_TIMEOUT_MS 30000
+#define MAX_QUEUED_TOOLCALLS 8
+// Calls asking for a bigger stack than the workers have run on their own threads
+#define MAX_DEDICATED_TOOLCALL_THREADS 2
+#define TOOLCALL_DEADLINE_CHECK_INTERVAL_US 200000
+#define MIN_PROGRESS_INTERVAL_US 500000
+
+// 没有 PSRAM 时只有一个工作任务以节省内部内存：一个卡住的工具会阻塞其后所有的调用，
+// 超时的调用会先回复错误，但排队的调用要等它返回后才能执行
+#if CONFIG_SPIRAM
+#define TOOLCALL_WORKER_COUNT 2
+#else
+#define TOOLCALL_WORKER_COUNT 1
+#endif
 
 McpServer::McpServer() {
 }
 
 McpServer::~McpServer() {
+    if (tool_call_timer_ != nullptr) {
+        esp_timer_stop(tool_call_timer_);
+        esp_timer_delete(tool_call_timer_);
+    }
     for (auto tool : tools_) {
         delete tool;
     }
@@ -83,9 +115,92 @@ void McpServer::AddCommonTools() {
             });
     }
 
+    if (display && display->has_lvgl_display()) {
+        AddTool("self.screen.get_perf_stats",
+            "Get the UI performance statistics of the screen as JSON: frame rate, render and flush wait time, "
+            "invalidated area, display lock wait time and heap usage. For debugging only.",
+            PropertyList(),
+            [display](const PropertyList& properties) -> ReturnValue {
+                return display->GetPerfStatsJson();
+            });
+
+        AddTool("self.screen.set_perf_hud",
+            "Show or hide the performance overlay on the screen. For debugging only.",
+            PropertyList({
+                Property("visible", kPropertyTypeBoolean)
+            }),
+            [display](const PropertyList& properties) -> ReturnValue {
+                display->SetPerfHudVisible(properties["visible"].value<bool>());
+                return true;
+            });
+
+        // 最近一次的截图，供后续的分块请求读取
+        auto screenshot = std::make_shared<std::string>();
+        auto screenshot_mutex = std::make_shared<std::mutex>();
+        auto screenshot_size = std::make_shared<std::pair<int, int>>(0, 0);
+        auto get_screenshot = new McpTool("self.screen.get_screenshot",
+            "Take a screenshot of the screen as a JPEG image, for debugging the UI only.\n"
+            "The image is returned in base64 chunks. Call with `chunk` 0 to take a new screenshot, "
+            "then call with `chunk` 1, 2, ... until `chunks` - 1 to read the rest of the same image.\n"
+            "Args:\n"
+            "  `chunk`: The chunk index to read, 0 takes a new screenshot.\n"
+            "  `quality`: The JPEG quality (1-100) of a new screenshot.\n"
+            "Return:\n"
+            "  A JSON object with the image size, the chunk count and the base64 data of the chunk.",
+            PropertyList({
+                Property("chunk", kPropertyTypeInteger, 0, 0, 1000),
+                Property("quality", kPropertyTypeInteger, 30, 1, 100)
+            }),
+            [display, screenshot, screenshot_mutex, screenshot_size](const PropertyList& properties) -> ReturnValue {
+                int chunk = properties["chunk"].value<int>();
+                std::lock_guard<std::mutex> lock(*screenshot_mutex);
+                if (chunk == 0) {
+                    if (!display->CaptureJpeg(*screenshot, properties["quality"].value<int>(),
+                            &screenshot_size->first, &screenshot_size->second)) {
+                        screenshot->clear();
+                        screenshot->shrink_to_fit();
+                        throw std::runtime_error("Failed to take screenshot");
+                    }
+                }
+                int chunks = (screenshot->size() + SCREENSHOT_CHUNK_SIZE - 1) / SCREENSHOT_CHUNK_SIZE;
+                if (chunks == 0) {
+                    throw std::runtime_error("No screenshot taken, call with chunk 0 first");
+                }
+                if (chunk >= chunks) {
+                    throw std::runtime_error("Invalid chunk index");
+                }
+                size_t offset = chunk * SCREENSHOT_CHUNK_SIZE;
+                size_t length = std::min<size_t>(SCREENSHOT_CHUNK_SIZE, screenshot->size() - offset);
+
+                char header[160];
+                snprintf(header, sizeof(header), "{\"format\":\"jpeg\",\"width\":%d,\"height\":%d,\"size\":%u,"
+                    "\"chunk\":%d,\"chunks\":%d,\"data\":\"", screenshot_size->first, screenshot_size->second,
+                    (unsigned)screenshot->size(), chunk, chunks);
+                std::string result = header;
+                size_t header_length = result.size();
+                size_t encoded_length = 0;
+                result.resize(header_length + (length + 2) / 3 * 4 + 1);
+                mbedtls_base64_encode((unsigned char*)&result[header_length], result.size() - header_length, &encoded_length,
+                    (const unsigned char*)screenshot->data() + offset, length);
+                result.resize(header_length + encoded_length);
+                result += "\"}";
+
+                if (chunk == chunks - 1) {
+                    // 最后一块读完后释放截图
+                    screenshot->clear();
+                    screenshot->shrink_to_fit();
+                }
+                return result;
+            });
+        get_screenshot->set_priority(kToolCallPriorityLow);
+        get_screenshot->set_timeout_ms(10000);
+        get_screenshot->set_stack_size(SCREENSHOT_STACK_SIZE);
+        AddTool(get_screenshot);
+    }
+
     auto camera = board.GetCamera();
     if (camera) {
-        AddTool("self.camera.take_photo",
+        auto take_photo = new McpTool("self.camera.take_photo",
             "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
             "Args:\n"
             "  `question`: The question that you want to ask about the photo.\n"
@@ -94,28 +209,36 @@ void McpServer::AddCommonTools() {
             PropertyList({
                 Property("question", kPropertyTypeString)
             }),
-            [camera](const PropertyList& properties) -> ReturnValue {
+            [this, camera](const PropertyList& properties) -> ReturnValue {
                 if (!camera->Capture()) {
                     return "{\"success\": false, \"message\": \"Failed to capture photo\"}";
                 }
+                ReportProgress(1, 2, "Photo captured, explaining");
                 auto question = properties["question"].value<std::string>();
                 return camera->Explain(question);
             });
+        // Capture, explain and upload take seconds, let quick controls run first
+        take_photo->set_priority(kToolCallPriorityLow);
+        take_photo->set_timeout_ms(60000);
+        AddTool(take_photo);
     }
 
     // Restore the original tools list to the end of the tools list
     tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
+    tools_list_dirty_ = true;
 }
 
 void McpServer::AddTool(McpTool* tool) {
     // Prevent adding duplicate tools
-    if (std::find_if(tools_.begin(), tools_.end(), [tool](const McpTool* t) { return t->name() == tool->name(); }) != tools_.end()) {
+    if (tools_by_name_.find(tool->name()) != tools_by_name_.end()) {
         ESP_LOGW(TAG, "Tool %s already added", tool->name().c_str());
         return;
     }
 
     ESP_LOGI(TAG, "Add tool: %s", tool->name().c_str());
     tools_.push_back(tool);
+    tools_by_name_[tool->name()] = tool;
+    tools_list_dirty_ = true;
 }
 
 void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
@@ -152,10 +275,44 @@ void McpServer::ParseCapabilities(const cJSON* capabilities) {
 }
 
 void McpServer::ParseMessage(const cJSON* json) {
+    if (cJSON_IsArray(json)) {
+        ParseBatch(json);
+        return;
+    }
+    ParseRequest(json, nullptr);
+}
+
+void McpServer::ParseBatch(const cJSON* json) {
+    // JSON-RPC 2.0 batch: requests are dispatched in order and their responses
+    // are sent back as a single array, notifications get no response
+    if (cJSON_GetArraySize(json) == 0) {
+        // An empty batch is answered with a single error, not an array
+        ESP_LOGE(TAG, "Empty batch");
+        ReplyInvalidRequest(nullptr);
+        return;
+    }
+
+    auto batch = std::make_shared<ReplyBatch>();
+    cJSON* request = nullptr;
+    cJSON_ArrayForEach(request, json) {
+        if (!cJSON_IsObject(request)) {
+            ESP_LOGE(TAG, "Invalid request in batch");
+            ReplyInvalidRequest(batch);
+            continue;
+        }
+        ParseRequest(request, batch);
+    }
+    ReleaseBatch(batch);
+}
+
+void McpServer::ParseRequest(const cJSON* json, const std::shared_ptr<ReplyBatch>& batch) {
     // Check JSONRPC version
     auto version = cJSON_GetObjectItem(json, "jsonrpc");
     if (version == nullptr || !cJSON_IsString(version) || strcmp(version->valuestring, "2.0") != 0) {
-        ESP_LOGE(TAG, "Invalid JSONRPC version: %s", version ? version->valuestring : "null");
+        ESP_LOGE(TAG, "Invalid JSONRPC version: %s", cJSON_IsString(version) ? version->valuestring : "null");
+        if (batch != nullptr) {
+            ReplyInvalidRequest(batch);
+        }
         return;
     }
     
@@ -163,11 +320,21 @@ void McpServer::ParseMessage(const cJSON* json) {
     auto method = cJSON_GetObjectItem(json, "method");
     if (method == nullptr || !cJSON_IsString(method)) {
         ESP_LOGE(TAG, "Missing method");
+        if (batch != nullptr) {
+            ReplyInvalidRequest(batch);
+        }
         return;
     }
     
     auto method_str = std::string(method->valuestring);
     if (method_str.find("notifications") == 0) {
+        if (method_str == "notifications/cancelled") {
+            auto params = cJSON_GetObjectItem(json, "params");
+            auto request_id = cJSON_GetObjectItem(params, "requestId");
+            if (cJSON_IsNumber(request_id)) {
+                CancelToolCall(request_id->valueint);
+            }
+        }
         return;
     }
     
@@ -175,12 +342,18 @@ void McpServer::ParseMessage(const cJSON* json) {
     auto params = cJSON_GetObjectItem(json, "params");
     if (params != nullptr && !cJSON_IsObject(params)) {
         ESP_LOGE(TAG, "Invalid params for method: %s", method_str.c_str());
+        if (batch != nullptr) {
+            ReplyInvalidRequest(batch);
+        }
         return;
     }
 
     auto id = cJSON_GetObjectItem(json, "id");
     if (id == nullptr || !cJSON_IsNumber(id)) {
         ESP_LOGE(TAG, "Invalid id for method: %s", method_str.c_str());
+        if (batch != nullptr) {
+            ReplyInvalidRequest(batch);
+        }
         return;
     }
     auto id_int = id->valueint;
@@ -192,11 +365,17 @@ void McpServer::ParseMessage(const cJSON* json) {
                 ParseCapabilities(capabilities);
             }
         }
+        if (tools_list_dirty_) {
+            BuildToolsListPages();
+        }
         auto app_desc = esp_app_get_description();
         std::string message = "{\"protocolVersion\":\"2024-11-05\",\"capabilities\":{\"tools\":{}},\"serverInfo\":{\"name\":\"" BOARD_NAME "\",\"version\":\"";
         message += app_desc->version;
+        // A server holding the tools of the same fingerprint can skip tools/list
+        message += "\"},\"_meta\":{\"toolsFingerprint\":\"";
+        message += tools_fingerprint_;
         message += "\"}}";
-        ReplyResult(id_int, message);
+        ReplyResult(id_int, message, batch);
     } else if (method_str == "tools/list") {
         std::string cursor_str = "";
         if (params != nullptr) {
@@ -205,163 +384,531 @@ void McpServer::ParseMessage(const cJSON* json) {
                 cursor_str = std::string(cursor->valuestring);
             }
         }
-        GetToolsList(id_int, cursor_str);
+        GetToolsList(id_int, cursor_str, batch);
     } else if (method_str == "tools/call") {
         if (!cJSON_IsObject(params)) {
             ESP_LOGE(TAG, "tools/call: Missing params");
-            ReplyError(id_int, "Missing params");
+            ReplyError(id_int, "Missing params", batch);
             return;
         }
         auto tool_name = cJSON_GetObjectItem(params, "name");
         if (!cJSON_IsString(tool_name)) {
             ESP_LOGE(TAG, "tools/call: Missing name");
-            ReplyError(id_int, "Missing name");
+            ReplyError(id_int, "Missing name", batch);
             return;
         }
         auto tool_arguments = cJSON_GetObjectItem(params, "arguments");
         if (tool_arguments != nullptr && !cJSON_IsObject(tool_arguments)) {
             ESP_LOGE(TAG, "tools/call: Invalid arguments");
-            ReplyError(id_int, "Invalid arguments");
+            ReplyError(id_int, "Invalid arguments", batch);
             return;
         }
         auto stack_size = cJSON_GetObjectItem(params, "stackSize");
         if (stack_size != nullptr && !cJSON_IsNumber(stack_size)) {
             ESP_LOGE(TAG, "tools/call: Invalid stackSize");
-            ReplyError(id_int, "Invalid stackSize");
+            ReplyError(id_int, "Invalid stackSize", batch);
             return;
         }
-        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments, stack_size ? stack_size->valueint : DEFAULT_TOOLCALL_STACK_SIZE);
+        std::string progress_token;
+        auto meta = cJSON_GetObjectItem(params, "_meta");
+        auto token = cJSON_IsObject(meta) ? cJSON_GetObjectItem(meta, "progressToken") : nullptr;
+        if (cJSON_IsString(token) || cJSON_IsNumber(token)) {
+            char* token_str = cJSON_PrintUnformatted(token);
+            progress_token = token_str;
+            cJSON_free(token_str);
+        }
+        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments, stack_size ? stack_size->valueint : DEFAULT_TOOLCALL_STACK_SIZE, progress_token, batch);
     } else {
         ESP_LOGE(TAG, "Method not implemented: %s", method_str.c_str());
-        ReplyError(id_int, "Method not implemented: " + method_str);
+        ReplyError(id_int, "Method not implemented: " + method_str, batch);
     }
 }
 
-void McpServer::ReplyResult(int id, const std::string& result) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id) + ",\"result\":";
+void McpServer::SendReply(std::string&& payload, const std::shared_ptr<ReplyBatch>& batch) {
+    if (batch == nullptr) {
+        SendMessage(std::move(payload));
+        return;
+    }
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    // The batch reply is one message, replies past the payload limit are dropped and
+    // reported by a single error entry, which always has room left for it
+    if (batch->dropped > 0 || batch->payload.size() + payload.size() + 2 + BATCH_DROPPED_ERROR_RESERVE > MAX_PAYLOAD_SIZE) {
+        batch->dropped++;
+        return;
+    }
+    batch->payload += batch->payload.empty() ? '[' : ',';
+    batch->payload += payload;
+}
+
+void McpServer::SendMessage(std::string&& payload) {
+#if CONFIG_MCP_SERVER_BENCHMARK
+    if (reply_sink_enabled_) {
+        // The benchmark only counts the replies, nothing goes to the server
+        reply_sink_bytes_ += payload.size();
+        return;
+    }
+#endif
+    Application::GetInstance().SendMcpMessage(std::move(payload));
+}
+
+void McpServer::ReleaseBatch(const std::shared_ptr<ReplyBatch>& batch) {
+    if (batch == nullptr || --batch->pending > 0) {
+        return;
+    }
+    std::string payload;
+    {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        if (batch->payload.empty() && batch->dropped == 0) {
+            return;
+        }
+        payload = std::move(batch->payload);
+    }
+    if (batch->dropped > 0) {
+        ESP_LOGE(TAG, "Batch reply exceeds %d bytes, dropped %d replies", MAX_PAYLOAD_SIZE, batch->dropped);
+        payload += payload.empty() ? '[' : ',';
+        payload += "{\"jsonrpc\":\"2.0\",\"id\":null,\"error\":{\"code\":-32603,\"message\":\"Batch reply too large, ";
+        payload += std::to_string(batch->dropped);
+        payload += " replies dropped\"}}";
+    }
+    payload += ']';
+    if (batch->local) {
+        ESP_LOGI(TAG, "Local reply: %s", payload.c_str());
+        return;
+    }
+    SendMessage(std::move(payload));
+}
+
+void McpServer::ReplyResult(int id, const std::string& result, const std::shared_ptr<ReplyBatch>& batch) {
+    std::string payload;
+    payload.reserve(result.size() + 48);
+    payload += "{\"jsonrpc\":\"2.0\",\"id\":";
+    payload += std::to_string(id);
+    payload += ",\"result\":";
     payload += result;
-    payload += "}";
-    Application::GetInstance().SendMcpMessage(payload);
+    payload += '}';
+    SendReply(std::move(payload), batch);
 }
 
-void McpServer::ReplyError(int id, const std::string& message) {
+void McpServer::ReplyError(int id, const std::string& message, const std::shared_ptr<ReplyBatch>& batch) {
     std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
     payload += std::to_string(id);
-    payload += ",\"error\":{\"message\":\"";
-    payload += message;
-    payload += "\"}}";
-    Application::GetInstance().SendMcpMessage(payload);
+    payload += ",\"error\":{\"message\":";
+    AppendJsonString(payload, message);
+    payload += "}}";
+    SendReply(std::move(payload), batch);
+}
+
+void McpServer::ReplyInvalidRequest(const std::shared_ptr<ReplyBatch>& batch) {
+    // JSON-RPC 2.0: the id of an invalid request cannot be trusted and is replied as null
+    SendReply(std::string("{\"jsonrpc\":\"2.0\",\"id\":null,\"error\":{\"code\":-32600,\"message\":\"Invalid Request\"}}"), batch);
+}
+
+void McpServer::GetToolsList(int id, const std::string& cursor, const std::shared_ptr<ReplyBatch>& batch) {
+    // The tool set is static after registration, so the pages are serialized
+    // once and served by cursor until the tools change
+    if (tools_list_dirty_) {
+        BuildToolsListPages();
+    }
+
+    for (const auto& page : tools_list_pages_) {
+        if (page.cursor != cursor) {
+            continue;
+        }
+        if (page.result.empty()) {
+            // 如果没有添加任何tool，返回错误
+            auto tool_name = cursor.empty() ? tools_.front()->name() : cursor;
+            ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", tool_name.c_str());
+            ReplyError(id, "Failed to add tool " + tool_name + " because of payload size limit", batch);
+            return;
+        }
+        ReplyResult(id, page.result, batch);
+        return;
+    }
+
+    ESP_LOGE(TAG, "tools/list: Invalid cursor: %s", cursor.c_str());
+    ReplyError(id, "Invalid cursor: " + cursor, batch);
 }
 
-void McpServer::GetToolsList(int id, const std::string& cursor) {
-    const int max_payload_size = 8000;
+void McpServer::BuildToolsListPages() {
+    int64_t start_time = esp_timer_get_time();
+
+    tools_list_pages_.clear();
+    std::string cursor = "";
     std::string json = "{\"tools\":[";
-    
-    bool found_cursor = cursor.empty();
-    auto it = tools_.begin();
-    std::string next_cursor = "";
-    
-    while (it != tools_.end()) {
-        // 如果我们还没有找到起始位置，继续搜索
-        if (!found_cursor) {
-            if ((*it)->name() == cursor) {
-                found_cursor = true;
+
+    // The fingerprint covers every tool schema in order, independent of the paging
+    mbedtls_sha256_context sha256_ctx;
+    mbedtls_sha256_init(&sha256_ctx);
+    mbedtls_sha256_starts(&sha256_ctx, 0);
+
+    for (auto tool : tools_) {
+        // 添加tool前检查大小
+        std::string tool_json = tool->to_json() + ",";
+        mbedtls_sha256_update(&sha256_ctx, (const unsigned char*)tool_json.data(), tool_json.size());
+        if (json.empty()) {
+            // A previous tool did not fit, only the fingerprint is still needed
+            continue;
+        }
+        if (json.length() + tool_json.length() + 30 > MAX_PAYLOAD_SIZE && json.back() != '[') {
+            // 如果添加这个tool会超出大小限制，结束当前页并以这个tool作为nextCursor
+            json.pop_back();
+            json += "],\"nextCursor\":\"" + tool->name() + "\"}";
+            tools_list_pages_.push_back({cursor, std::move(json)});
+            cursor = tool->name();
+            json = "{\"tools\":[";
+        }
+        if (json.length() + tool_json.length() + 30 > MAX_PAYLOAD_SIZE) {
+            // The tool does not fit into an empty page, leave the page empty to reply an error
+            json.clear();
+            continue;
+        }
+        json += tool_json;
+    }
+
+    unsigned char digest[32];
+    mbedtls_sha256_finish(&sha256_ctx, digest);
+    mbedtls_sha256_free(&sha256_ctx);
+    char hex[33];
+    for (int i = 0; i < 16; i++) {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+    tools_fingerprint_ = hex;
+
+    if (!json.empty()) {
+        if (json.back() == ',') {
+            json.pop_back();
+        }
+        json += "]}";
+    }
+    tools_list_pages_.push_back({cursor, std::move(json)});
+    tools_list_dirty_ = false;
+
+    size_t total_size = 0;
+    for (const auto& page : tools_list_pages_) {
+        total_size += page.result.size();
+    }
+    ESP_LOGI(TAG, "tools/list: %u tools serialized into %u pages (%u bytes) in %d us, fingerprint %s",
+        (unsigned)tools_.size(), (unsigned)tools_list_pages_.size(), (unsigned)total_size,
+        (int)(esp_timer_get_time() - start_time), tools_fingerprint_.c_str());
+}
+
+bool McpServer::BindArguments(int id, const McpTool* tool, const cJSON* tool_arguments, std::vector<PropertyValue>& slots, const std::shared_ptr<ReplyBatch>& batch) {
+    const auto& properties = tool->properties();
+    slots.reserve(properties.size());
+    try {
+        for (size_t i = 0; i < properties.size(); ++i) {
+            const auto& property = properties.at(i);
+            auto value = cJSON_IsObject(tool_arguments) ? cJSON_GetObjectItem(tool_arguments, property.name().c_str()) : nullptr;
+            if (property.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
+                slots.emplace_back(value->valueint == 1);
+            } else if (property.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
+                property.check_range(value->valueint);
+                slots.emplace_back(value->valueint);
+            } else if (property.type() == kPropertyTypeString && cJSON_IsString(value)) {
+                slots.emplace_back(std::string(value->valuestring));
+            } else if (property.has_default_value()) {
+                slots.emplace_back(property.raw_value());
             } else {
-                ++it;
-                continue;
+                ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", property.name().c_str());
+                ReplyError(id, "Missing valid argument: " + property.name(), batch);
+                return false;
             }
         }
-        
-        // 添加tool前检查大小
-        std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
-            // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
-            next_cursor = (*it)->name();
+    } catch (const std::exception& e) {
+        ESP_LOGE(TAG, "tools/call: %s", e.what());
+        ReplyError(id, e.what(), batch);
+        return false;
+    }
+    return true;
+}
+
+void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size, const std::string& progress_token, const std::shared_ptr<ReplyBatch>& batch) {
+    auto tool_iter = tools_by_name_.find(tool_name);
+    if (tool_iter == tools_by_name_.end()) {
+        ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
+        ReplyError(id, "Unknown tool: " + tool_name, batch);
+        return;
+    }
+    auto tool = tool_iter->second;
+
+    // Bind the arguments by property position, the property metadata stays in the tool
+    std::vector<PropertyValue> slots;
+    if (!BindArguments(id, tool, tool_arguments, slots, batch)) {
+        return;
+    }
+
+    auto call = std::make_shared<ToolCall>();
+    call->id = id;
+    call->tool = tool;
+    call->slots = std::move(slots);
+    call->batch = batch;
+    call->progress_token = progress_token;
+    call->enqueue_time = esp_timer_get_time();
+    int timeout_ms = tool->timeout_ms() > 0 ? tool->timeout_ms() : DEFAULT_TOOLCALL_TIMEOUT_MS;
+    call->deadline = call->enqueue_time + timeout_ms * 1000LL;
+
+    std::unique_lock<std::mutex> lock(tool_call_mutex_);
+    if (!tool_call_workers_started_) {
+        StartToolCallWorkers();
+    }
+    stack_size = std::max(stack_size, tool->stack_size());
+    bool dedicated_thread = stack_size > DEFAULT_TOOLCALL_STACK_SIZE;
+    if (queued_tool_calls_ >= MAX_QUEUED_TOOLCALLS ||
+            (dedicated_thread && dedicated_tool_call_threads_ >= MAX_DEDICATED_TOOLCALL_THREADS)) {
+        lock.unlock();
+        ESP_LOGE(TAG, "tools/call: Too many pending tool calls, reject %s", tool_name.c_str());
+        ReplyError(id, "Too many pending tool calls", batch);
+        return;
+    }
+    if (batch != nullptr) {
+        // Released when the call replies, times out or is cancelled
+        batch->pending++;
+    }
+    if (!esp_timer_is_active(tool_call_timer_)) {
+        esp_timer_start_periodic(tool_call_timer_, TOOLCALL_DEADLINE_CHECK_INTERVAL_US);
+    }
+
+    if (dedicated_thread) {
+        // The workers cannot grow their stacks, run the call on its own thread
+        call->running = true;
+        running_tool_calls_.push_back(call);
+        dedicated_tool_call_threads_++;
+        lock.unlock();
+
+        esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+        cfg.thread_name = "tool_call";
+        cfg.stack_size = stack_size;
+        cfg.prio = 1;
+        esp_pthread_set_cfg(&cfg);
+        std::thread([this, call]() {
+            RunToolCall(call);
+            std::lock_guard<std::mutex> lock(tool_call_mutex_);
+            dedicated_tool_call_threads_--;
+        }).detach();
+        return;
+    }
+
+    tool_call_queues_[tool->priority()].push_back(call);
+    queued_tool_calls_++;
+    tool_call_cv_.notify_one();
+}
+
+void McpServer::CallToolLocally(const std::string& name, const cJSON* arguments) {
+    auto batch = std::make_shared<ReplyBatch>();
+    batch->local = true;
+    DoToolCall(-1, name, arguments, DEFAULT_TOOLCALL_STACK_SIZE, "", batch);
+    ReleaseBatch(batch);
+}
+
+void McpServer::StartToolCallWorkers() {
+    size_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    for (int i = 0; i < TOOLCALL_WORKER_COUNT; i++) {
+#if CONFIG_SPIRAM_XIP_FROM_PSRAM
+        // Tools write settings to flash, which is only allowed from a PSRAM stack
+        // when the code and data are executed from PSRAM
+        auto stack = (StackType_t*)heap_caps_malloc(DEFAULT_TOOLCALL_STACK_SIZE, MALLOC_CAP_SPIRAM);
+#else
+        auto stack = (StackType_t*)heap_caps_malloc(DEFAULT_TOOLCALL_STACK_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#endif
+        auto task_buffer = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (stack == nullptr || task_buffer == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate tool call worker %d", i);
+            heap_caps_free(stack);
+            heap_caps_free(task_buffer);
             break;
         }
-        
-        json += tool_json;
-        ++it;
+        xTaskCreateStatic([](void* arg) {
+            auto server = (McpServer*)arg;
+            server->ToolCallWorkerLoop();
+        }, "tool_call", DEFAULT_TOOLCALL_STACK_SIZE, this, 1, stack, task_buffer);
     }
-    
-    if (json.back() == ',') {
-        json.pop_back();
+
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto server = (McpServer*)arg;
+            server->CheckToolCallDeadlines();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "tool_call_timer",
+        .skip_unhandled_events = true
+    };
+    esp_timer_create(&timer_args, &tool_call_timer_);
+    tool_call_workers_started_ = true;
+
+    ESP_LOGI(TAG, "Started %d tool call workers, internal heap used: %d bytes", TOOLCALL_WORKER_COUNT,
+        (int)(free_internal - heap_caps_get_free_size(MALLOC_CAP_INTERNAL)));
+}
+
+void McpServer::ToolCallWorkerLoop() {
+    while (true) {
+        std::shared_ptr<ToolCall> call;
+        {
+            std::unique_lock<std::mutex> lock(tool_call_mutex_);
+            tool_call_cv_.wait(lock, [this]() { return queued_tool_calls_ > 0; });
+            for (auto& queue : tool_call_queues_) {
+                if (!queue.empty()) {
+                    call = std::move(queue.front());
+                    queue.pop_front();
+                    break;
+                }
+            }
+            queued_tool_calls_--;
+            call->running = true;
+            running_tool_calls_.push_back(call);
+        }
+        RunToolCall(call);
     }
-    
-    if (json.back() == '[' && !tools_.empty()) {
-        // 如果没有添加任何tool，返回错误
-        ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
-        ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
-        return;
+}
+
+thread_local McpServer::ToolCall* McpServer::current_tool_call_ = nullptr;
+
+void McpServer::RunToolCall(std::shared_ptr<ToolCall> call) {
+    int64_t start_time = esp_timer_get_time();
+    call->start_time = start_time;
+    call->last_progress_time = start_time;
+    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
+    payload += std::to_string(call->id);
+    payload += ",\"result\":";
+    std::string error;
+    try {
+        PropertyList arguments(call->tool->properties(), call->slots.data());
+        current_tool_call_ = call.get();
+        call->tool->Call(arguments, payload);
+        payload += '}';
+    } catch (const std::exception& e) {
+        ESP_LOGE(TAG, "tools/call: %s", e.what());
+        error = e.what();
+    }
+    current_tool_call_ = nullptr;
+    int64_t end_time = esp_timer_get_time();
+    ESP_LOGI(TAG, "tools/call: %s queued %d ms, ran %d ms", call->tool->name().c_str(),
+        (int)((start_time - call->enqueue_time) / 1000), (int)((end_time - start_time) / 1000));
+    if (on_tool_call_completed_) {
+        on_tool_call_completed_();
     }
 
-    if (next_cursor.empty()) {
-        json += "]}";
+    {
+        std::lock_guard<std::mutex> lock(tool_call_mutex_);
+        running_tool_calls_.remove(call);
+        if (call->replied) {
+            ESP_LOGW(TAG, "tools/call: Drop the result of %s (id %d)", call->tool->name().c_str(), call->id);
+            return;
+        }
+        call->replied = true;
+    }
+
+    if (error.empty()) {
+        SendReply(std::move(payload), call->batch);
     } else {
-        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+        ReplyError(call->id, error, call->batch);
     }
-    
-    ReplyResult(id, json);
+    ReleaseBatch(call->batch);
 }
 
-void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size) {
-    auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
-                                 [&tool_name](const McpTool* tool) { 
-                                     return tool->name() == tool_name; 
-                                 });
-    
-    if (tool_iter == tools_.end()) {
-        ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
-        ReplyError(id, "Unknown tool: " + tool_name);
+void McpServer::ReportProgress(int progress, int total, const std::string& message) {
+    auto call = current_tool_call_;
+    if (call == nullptr) {
+        ESP_LOGW(TAG, "ReportProgress: Not called from a tool call");
         return;
     }
+    int64_t now = esp_timer_get_time();
+    int phase_ms = (int)((now - call->last_progress_time) / 1000);
+    int elapsed_ms = (int)((now - call->start_time) / 1000);
+    call->last_progress_time = now;
+    ESP_LOGI(TAG, "tools/call: %s progress %d/%d %s, phase %d ms, elapsed %d ms", call->tool->name().c_str(),
+        progress, total, message.c_str(), phase_ms, elapsed_ms);
 
-    PropertyList arguments = (*tool_iter)->properties();
-    try {
-        for (auto& argument : arguments) {
-            bool found = false;
-            if (cJSON_IsObject(tool_arguments)) {
-                auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
-                if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
-                    argument.set_value<bool>(value->valueint == 1);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
-                    argument.set_value<int>(value->valueint);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
-                    argument.set_value<std::string>(value->valuestring);
-                    found = true;
+    if (call->progress_token.empty()) {
+        return;
+    }
+    // Phases closer than the interval are only logged, so a chatty tool cannot flood the link
+    if (call->last_progress_sent_time != 0 && now - call->last_progress_sent_time < MIN_PROGRESS_INTERVAL_US) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(tool_call_mutex_);
+        if (call->replied) {
+            return;
+        }
+    }
+    call->last_progress_sent_time = now;
+
+    std::string payload = "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/progress\",\"params\":{\"progressToken\":";
+    payload += call->progress_token;
+    payload += ",\"progress\":";
+    payload += std::to_string(progress);
+    if (total > 0) {
+        payload += ",\"total\":";
+        payload += std::to_string(total);
+    }
+    payload += ",\"message\":";
+    AppendJsonString(payload, message + " (" + std::to_string(elapsed_ms) + " ms)");
+    payload += "}}";
+    SendMessage(std::move(payload));
+}
+
+void McpServer::CheckToolCallDeadlines() {
+    std::vector<std::shared_ptr<ToolCall>> expired_calls;
+    {
+        std::lock_guard<std::mutex> lock(tool_call_mutex_);
+        auto now = esp_timer_get_time();
+        for (auto& queue : tool_call_queues_) {
+            for (auto it = queue.begin(); it != queue.end();) {
+                if ((*it)->deadline <= now) {
+                    expired_calls.push_back(*it);
+                    it = queue.erase(it);
+                    queued_tool_calls_--;
+                } else {
+                    ++it;
                 }
             }
+        }
+        // A running tool cannot be interrupted safely, reply now and drop its result later
+        bool waiting = false;
+        for (auto& call : running_tool_calls_) {
+            if (!call->replied && call->deadline <= now) {
+                call->replied = true;
+                expired_calls.push_back(call);
+            }
+            waiting = waiting || !call->replied;
+        }
+        // Calls that already replied stay in the running list until the tool returns,
+        // there is no deadline left to check for them
+        if (queued_tool_calls_ == 0 && !waiting) {
+            esp_timer_stop(tool_call_timer_);
+        }
+    }
 
-            if (!argument.has_default_value() && !found) {
-                ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", argument.name().c_str());
-                ReplyError(id, "Missing valid argument: " + argument.name());
+    for (auto& call : expired_calls) {
+        ESP_LOGW(TAG, "tools/call: Timeout %s (id %d)", call->tool->name().c_str(), call->id);
+        ReplyError(call->id, "Tool call timed out", call->batch);
+        ReleaseBatch(call->batch);
+    }
+}
+
+void McpServer::CancelToolCall(int id) {
+    // The receiver of a cancellation must not send a response for the request
+    std::lock_guard<std::mutex> lock(tool_call_mutex_);
+    for (auto& queue : tool_call_queues_) {
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if ((*it)->id == id) {
+                ESP_LOGI(TAG, "tools/call: Cancelled %s (id %d) before it started", (*it)->tool->name().c_str(), id);
+                ReleaseBatch((*it)->batch);
+                queue.erase(it);
+                queued_tool_calls_--;
                 return;
             }
         }
-    } catch (const std::exception& e) {
-        ESP_LOGE(TAG, "tools/call: %s", e.what());
-        ReplyError(id, e.what());
-        return;
     }
-
-    // Start a task to receive data with stack size
-    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
-    cfg.thread_name = "tool_call";
-    cfg.stack_size = stack_size;
-    cfg.prio = 1;
-    esp_pthread_set_cfg(&cfg);
-
-    // Use a thread to call the tool to avoid blocking the main thread
-    tool_call_thread_ = std::thread([this, id, tool_iter, arguments = std::move(arguments)]() {
-        try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
-        } catch (const std::exception& e) {
-            ESP_LOGE(TAG, "tools/call: %s", e.what());
-            ReplyError(id, e.what());
-        }
-    });
-    tool_call_thread_.detach();
-}
\ No newline at end of file
+    for (auto& call : running_tool_calls_) {
+        if (call->id == id) {
+            ESP_LOGI(TAG, "tools/call: Cancelled %s (id %d), the result will be dropped", call->tool->name().c_str(), id);
+            if (!call->replied) {
+                call->replied = true;
+                ReleaseBatch(call->batch);
+            }
+            return;
+        }
+    }
+}
@@ -4,16 +4,59 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <functional>
 #include <variant>
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
 
 #include <cJSON.h>
+#include <esp_timer.h>
+
+// Appends a JSON string literal with the required escaping
+inline void AppendJsonString(std::string& output, const std::string& value) {
+    output.reserve(output.size() + value.size() + 2);
+    output += '"';
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': output += "\\\""; break;
+            case '\\': output += "\\\\"; break;
+            case '\b': output += "\\b"; break;
+            case '\f': output += "\\f"; break;
+            case '\n': output += "\\n"; break;
+            case '\r': output += "\\r"; break;
+            case '\t': output += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    output += escaped;
+                } else {
+                    output += (char)c;
+                }
+                break;
+        }
+    }
+    output += '"';
+}
 
 // 添加类型别名
 using ReturnValue = std::variant<bool, int, std::string>;
+using PropertyValue = std::variant<bool, int, std::string>;
+
+enum ToolCallPriority {
+    kToolCallPriorityHigh,
+    kToolCallPriorityNormal,
+    kToolCallPriorityLow,
+    kToolCallPriorityCount
+};
 
 enum PropertyType {
     kPropertyTypeBoolean,
@@ -25,7 +68,7 @@ class Property {
 private:
     std::string name_;
     PropertyType type_;
-    std::variant<bool, int, std::string> value_;
+    PropertyValue value_;
     bool has_default_value_;
     std::optional<int> min_value_;  // 新增：整数最小值
     std::optional<int> max_value_;  // 新增：整数最大值
@@ -67,6 +110,8 @@ public:
     inline int min_value() const { return min_value_.value_or(0); }
     inline int max_value() const { return max_value_.value_or(0); }
 
+    inline const PropertyValue& raw_value() const { return value_; }
+
     template<typename T>
     inline T value() const {
         return std::get<T>(value_);
@@ -76,16 +121,20 @@ public:
     inline void set_value(const T& value) {
         // 添加对设置的整数值进行范围检查
         if constexpr (std::is_same_v<T, int>) {
-            if (min_value_.has_value() && value < min_value_.value()) {
-                throw std::invalid_argument("Value is below minimum allowed: " + std::to_string(min_value_.value()));
-            }
-            if (max_value_.has_value() && value > max_value_.value()) {
-                throw std::invalid_argument("Value exceeds maximum allowed: " + std::to_string(max_value_.value()));
-            }
+            check_range(value);
         }
         value_ = value;
     }
 
+    inline void check_range(int value) const {
+        if (min_value_.has_value() && value < min_value_.value()) {
+            throw std::invalid_argument("Value is below minimum allowed: " + std::to_string(min_value_.value()));
+        }
+        if (max_value_.has_value() && value > max_value_.value()) {
+            throw std::invalid_argument("Value exceeds maximum allowed: " + std::to_string(max_value_.value()));
+        }
+    }
+
     std::string to_json() const {
         cJSON *json = cJSON_CreateObject();
         
@@ -121,32 +170,66 @@ public:
     }
 };
 
+// Read-only access to a property value, either the default of a declared
+// property or an argument bound into a call slot
+class PropertyValueRef {
+private:
+    const PropertyValue& value_;
+
+public:
+    explicit PropertyValueRef(const PropertyValue& value) : value_(value) {}
+
+    template<typename T>
+    inline T value() const {
+        return std::get<T>(value_);
+    }
+};
+
 class PropertyList {
 private:
     std::vector<Property> properties_;
+    // Set when the list is a view of bound call arguments. Names and types are
+    // read from the tool's own list, values from the slots in property order.
+    const PropertyList* declaration_ = nullptr;
+    const PropertyValue* slots_ = nullptr;
 
 public:
     PropertyList() = default;
     PropertyList(const std::vector<Property>& properties) : properties_(properties) {}
+    PropertyList(const PropertyList& declaration, const PropertyValue* slots)
+        : declaration_(&declaration), slots_(slots) {}
     void AddProperty(const Property& property) {
+        if (declaration_ != nullptr) {
+            throw std::logic_error("Cannot add a property to bound call arguments");
+        }
         properties_.push_back(property);
     }
 
-    const Property& operator[](const std::string& name) const {
-        for (const auto& property : properties_) {
-            if (property.name() == name) {
-                return property;
+    // The declared properties, shared with the tool's own list on a view
+    inline const std::vector<Property>& properties() const {
+        return declaration_ ? declaration_->properties_ : properties_;
+    }
+
+    PropertyValueRef operator[](const std::string& name) const {
+        const auto& properties = this->properties();
+        for (size_t i = 0; i < properties.size(); ++i) {
+            if (properties[i].name() == name) {
+                return PropertyValueRef(slots_ ? slots_[i] : properties[i].raw_value());
             }
         }
         throw std::runtime_error("Property not found: " + name);
     }
 
-    auto begin() { return properties_.begin(); }
-    auto end() { return properties_.end(); }
+    // On a view these describe the declaration, the bound values are only read through operator[]
+    inline size_t size() const { return properties().size(); }
+    inline const Property& at(size_t index) const { return properties()[index]; }
+
+    auto begin() const { return properties().begin(); }
+    auto end() const { return properties().end(); }
 
     std::vector<std::string> GetRequired() const {
         std::vector<std::string> required;
-        for (auto& property : properties_) {
+        for (auto& property : properties()) {
             if (!property.has_default_value()) {
                 required.push_back(property.name());
             }
@@ -157,7 +240,7 @@ public:
     std::string to_json() const {
         cJSON *json = cJSON_CreateObject();
         
-        for (const auto& property : properties_) {
+        for (const auto& property : properties()) {
             cJSON *prop_json = cJSON_Parse(property.to_json().c_str());
             cJSON_AddItemToObject(json, property.name().c_str(), prop_json);
         }
@@ -177,6 +260,9 @@ private:
     std::string description_;
     PropertyList properties_;
     std::function<ReturnValue(const PropertyList&)> callback_;
+    ToolCallPriority priority_ = kToolCallPriorityNormal;
+    int timeout_ms_ = 0;  // 0: use the server default
+    int stack_size_ = 0;  // 0: run on the tool call workers
 
 public:
     McpTool(const std::string& name, 
@@ -191,6 +277,12 @@ public:
     inline const std::string& name() const { return name_; }
     inline const std::string& description() const { return description_; }
     inline const PropertyList& properties() const { return properties_; }
+    inline ToolCallPriority priority() const { return priority_; }
+    inline int timeout_ms() const { return timeout_ms_; }
+    inline int stack_size() const { return stack_size_; }
+    inline void set_priority(ToolCallPriority priority) { priority_ = priority; }
+    inline void set_timeout_ms(int timeout_ms) { timeout_ms_ = timeout_ms; }
+    inline void set_stack_size(int stack_size) { stack_size_ = stack_size; }
 
     std::string to_json() const {
         std::vector<std::string> required = properties_.GetRequired();
@@ -223,29 +315,21 @@ public:
         return result;
     }
 
-    std::string Call(const PropertyList& properties) {
+    // Writes the tool result straight into the response being built
+    void Call(const PropertyList& properties, std::string& output) {
         ReturnValue return_value = callback_(properties);
         // 返回结果
-        cJSON* result = cJSON_CreateObject();
-        cJSON* content = cJSON_CreateArray();
-        cJSON* text = cJSON_CreateObject();
-        cJSON_AddStringToObject(text, "type", "text");
+        output += "{\"content\":[{\"type\":\"text\",\"text\":";
         if (std::holds_alternative<std::string>(return_value)) {
-            cJSON_AddStringToObject(text, "text", std::get<std::string>(return_value).c_str());
+            AppendJsonString(output, std::get<std::string>(return_value));
         } else if (std::holds_alternative<bool>(return_value)) {
-            cJSON_AddStringToObject(text, "text", std::get<bool>(return_value) ? "true" : "false");
+            output += std::get<bool>(return_value) ? "\"true\"" : "\"false\"";
         } else if (std::holds_alternative<int>(return_value)) {
-            cJSON_AddStringToObject(text, "text", std::to_string(std::get<int>(return_value)).c_str());
+            output += '"';
+            output += std::to_string(std::get<int>(return_value));
+            output += '"';
         }
-        cJSON_AddItemToArray(content, text);
-        cJSON_AddItemToObject(result, "content", content);
-        cJSON_AddBoolToObject(result, "isError", false);
-
-        auto json_str = cJSON_PrintUnformatted(result);
-        std::string result_str(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(result);
-        return result_str;
+        output += "}],\"isError\":false}";
     }
 };
 
@@ -262,20 +346,99 @@ public:
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
 
+    // Run a tool on the tool call workers for an on-device caller, the reply is only logged
+    void CallToolLocally(const std::string& name, const cJSON* arguments);
+    bool HasTool(const std::string& name) const { return tools_by_name_.find(name) != tools_by_name_.end(); }
+    // Called on the tool call thread after every tool returns, the tool may have changed the device status.
+    // Set once at startup, before the first tool call.
+    void OnToolCallCompleted(std::function<void()> callback) { on_tool_call_completed_ = callback; }
+    // Replay synthetic and malformed JSON-RPC traffic, log the latency and heap usage
+    // (only built with CONFIG_MCP_SERVER_BENCHMARK)
+    void RunBenchmark();
+
+    // Called from a tool callback to report a phase of a long-running call. Sent as
+    // notifications/progress when the client asked for it with a progress token.
+    void ReportProgress(int progress, int total, const std::string& message);
+
 private:
     McpServer();
     ~McpServer();
 
     void ParseCapabilities(const cJSON* capabilities);
 
-    void ReplyResult(int id, const std::string& result);
-    void ReplyError(int id, const std::string& message);
-
-    void GetToolsList(int id, const std::string& cursor);
-    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size);
+    // Responses of a JSON-RPC batch, sent as one array when the last pending
+    // tool call of the batch has replied
+    struct ReplyBatch {
+        std::mutex mutex;
+        std::string payload;
+        std::atomic<int> pending{1};  // Held by the parser until the batch is dispatched
+        bool local = false;  // Called on the device, nothing is sent to the server
+        int dropped = 0;  // Replies that did not fit in the payload limit
+    };
+
+    void ParseRequest(const cJSON* json, const std::shared_ptr<ReplyBatch>& batch);
+    void ParseBatch(const cJSON* json);
+    void SendMessage(std::string&& payload);
+    void SendReply(std::string&& payload, const std::shared_ptr<ReplyBatch>& batch);
+    void ReleaseBatch(const std::shared_ptr<ReplyBatch>& batch);
+    void ReplyResult(int id, const std::string& result, const std::shared_ptr<ReplyBatch>& batch = nullptr);
+    void ReplyError(int id, const std::string& message, const std::shared_ptr<ReplyBatch>& batch = nullptr);
+    void ReplyInvalidRequest(const std::shared_ptr<ReplyBatch>& batch);
+
+    // A serialized tools/list result, served to the cursor that starts it
+    struct ToolsListPage {
+        std::string cursor;
+        std::string result;
+    };
+
+    // A tools/call request waiting for, or running on, a worker
+    struct ToolCall {
+        int id;
+        McpTool* tool;
+        std::vector<PropertyValue> slots;
+        std::shared_ptr<ReplyBatch> batch;
+        int64_t enqueue_time;
+        int64_t deadline;
+        std::string progress_token;  // Serialized params._meta.progressToken, empty if not requested
+        int64_t start_time = 0;
+        int64_t last_progress_time = 0;
+        int64_t last_progress_sent_time = 0;
+        bool running = false;
+        bool replied = false;  // Timed out or cancelled, the result is dropped
+    };
+
+    void GetToolsList(int id, const std::string& cursor, const std::shared_ptr<ReplyBatch>& batch);
+    void BuildToolsListPages();
+    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size, const std::string& progress_token, const std::shared_ptr<ReplyBatch>& batch);
+    bool BindArguments(int id, const McpTool* tool, const cJSON* tool_arguments, std::vector<PropertyValue>& slots, const std::shared_ptr<ReplyBatch>& batch);
+    void StartToolCallWorkers();
+    void ToolCallWorkerLoop();
+    void RunToolCall(std::shared_ptr<ToolCall> call);
+    void CheckToolCallDeadlines();
+    void CancelToolCall(int id);
+
+    static thread_local ToolCall* current_tool_call_;  // The call running on this thread
 
     std::vector<McpTool*> tools_;
-    std::thread tool_call_thread_;
+    std::unordered_map<std::string, McpTool*> tools_by_name_;
+    std::vector<ToolsListPage> tools_list_pages_;
+    std::string tools_fingerprint_;
+    bool tools_list_dirty_ = true;
+
+    std::mutex tool_call_mutex_;
+    std::condition_variable tool_call_cv_;
+    std::list<std::shared_ptr<ToolCall>> tool_call_queues_[kToolCallPriorityCount];
+    std::list<std::shared_ptr<ToolCall>> running_tool_calls_;
+    size_t queued_tool_calls_ = 0;
+    size_t dedicated_tool_call_threads_ = 0;
+    bool tool_call_workers_started_ = false;
+    esp_timer_handle_t tool_call_timer_ = nullptr;
+    std::function<void()> on_tool_call_completed_;
+#if CONFIG_MCP_SERVER_BENCHMARK
+    // Set while the benchmark runs, the replies are counted instead of sent
+    std::atomic<bool> reply_sink_enabled_{false};
+    std::atomic<size_t> reply_sink_bytes_{0};
+#endif
 };
 
 #endif // MCP_SERVER_H
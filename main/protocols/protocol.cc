@@ -65,49 +65,19 @@ void Protocol::SendStopListening() {
     SendText(message);
 }
 
-void Protocol::SendIotDescriptors(const std::string& descriptors) {
-    cJSON* root = cJSON_Parse(descriptors.c_str());
-    if (root == nullptr) {
-        ESP_LOGE(TAG, "Failed to parse IoT descriptors: %s", descriptors.c_str());
-        return;
+void Protocol::SendIotDescriptors(const std::vector<std::string>& descriptors) {
+    // The descriptors are already serialized, wrap each into its own message
+    std::string message;
+    for (const auto& descriptor : descriptors) {
+        message.clear();
+        message.reserve(descriptor.size() + session_id_.size() + 64);
+        message += "{\"session_id\":\"";
+        message += session_id_;
+        message += "\",\"type\":\"iot\",\"update\":true,\"descriptors\":[";
+        message += descriptor;
+        message += "]}";
+        SendText(message);
     }
-
-    if (!cJSON_IsArray(root)) {
-        ESP_LOGE(TAG, "IoT descriptors should be an array");
-        cJSON_Delete(root);
-        return;
-    }
-
-    int arraySize = cJSON_GetArraySize(root);
-    for (int i = 0; i < arraySize; ++i) {
-        cJSON* descriptor = cJSON_GetArrayItem(root, i);
-        if (descriptor == nullptr) {
-            ESP_LOGE(TAG, "Failed to get IoT descriptor at index %d", i);
-            continue;
-        }
-
-        cJSON* messageRoot = cJSON_CreateObject();
-        cJSON_AddStringToObject(messageRoot, "session_id", session_id_.c_str());
-        cJSON_AddStringToObject(messageRoot, "type", "iot");
-        cJSON_AddBoolToObject(messageRoot, "update", true);
-
-        cJSON* descriptorArray = cJSON_CreateArray();
-        cJSON_AddItemToArray(descriptorArray, cJSON_Duplicate(descriptor, 1));
-        cJSON_AddItemToObject(messageRoot, "descriptors", descriptorArray);
-
-        char* message = cJSON_PrintUnformatted(messageRoot);
-        if (message == nullptr) {
-            ESP_LOGE(TAG, "Failed to print JSON message for IoT descriptor at index %d", i);
-            cJSON_Delete(messageRoot);
-            continue;
-        }
-
-        SendText(std::string(message));
-        cJSON_free(message);
-        cJSON_Delete(messageRoot);
-    }
-
-    cJSON_Delete(root);
 }
 
 void Protocol::SendIotStates(const std::string& states) {
@@ -116,7 +86,14 @@ void Protocol::SendIotStates(const std::string& states) {
 }
 
 void Protocol::SendMcpMessage(const std::string& payload) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":" + payload + "}";
+    // MCP results can be several KB, the envelope is built in one buffer sized up front
+    std::string message;
+    message.reserve(session_id_.size() + payload.size() + 48);
+    message += "{\"session_id\":\"";
+    message += session_id_;
+    message += "\",\"type\":\"mcp\",\"payload\":";
+    message += payload;
+    message += '}';
     SendText(message);
 }
 
@@ -11,6 +11,7 @@ struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // Arrival order of server audio, 0 for local sounds
     std::vector<uint8_t> payload;
 };
 
@@ -70,9 +71,9 @@ public:
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
-    virtual void SendIotDescriptors(const std::string& descriptors);
+    virtual void SendIotDescriptors(const std::vector<std::string>& descriptors);
     virtual void SendIotStates(const std::string& states);
-    virtual void SendMcpMessage(const std::string& message);
+    virtual void SendMcpMessage(const std::string& payload);
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
@@ -33,8 +33,10 @@ bool WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
         return false;
     }
 
+    // Reuse the send buffer across frames, so the 60ms audio path does not
+    // allocate a new string for every packet before it is masked and sent
     if (version_ == 2) {
-        std::string serialized;
+        auto& serialized = send_buffer_;
         serialized.resize(sizeof(BinaryProtocol2) + packet.payload.size());
         auto bp2 = (BinaryProtocol2*)serialized.data();
         bp2->version = htons(version_);
@@ -46,7 +48,7 @@ bool WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
 
         return websocket_->Send(serialized.data(), serialized.size(), true);
     } else if (version_ == 3) {
-        std::string serialized;
+        auto& serialized = send_buffer_;
         serialized.resize(sizeof(BinaryProtocol3) + packet.payload.size());
         auto bp3 = (BinaryProtocol3*)serialized.data();
         bp3->type = 0;
@@ -0,0 +1,496 @@
+#include "rule_engine.h"
+#include <esp_log.h>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "application.h"
+#include "board.h"
+#include "mcp_server.h"
+#include "settings.h"
+
+#define TAG "RuleEngine"
+
+#define MAX_RULES 8
+// NVS strings are limited to 4000 bytes
+#define MAX_RULES_JSON_SIZE 3800
+#define MINUTES_PER_DAY (24 * 60)
+
+RuleEngine::RuleEngine() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto engine = (RuleEngine*)arg;
+            engine->Notify();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "rule_time",
+        .skip_unhandled_events = true
+    };
+    esp_timer_create(&timer_args, &time_timer_);
+}
+
+RuleEngine::~RuleEngine() {
+    if (time_timer_ != nullptr) {
+        esp_timer_stop(time_timer_);
+        esp_timer_delete(time_timer_);
+    }
+    ClearRules();
+}
+
+void RuleEngine::Initialize() {
+    LoadRules();
+    AddTools();
+    Notify();
+}
+
+void RuleEngine::Notify() {
+    // Coalesce the events until the main loop runs the evaluation
+    if (evaluation_pending_.exchange(true)) {
+        return;
+    }
+    Application::GetInstance().Schedule([this]() {
+        evaluation_pending_ = false;
+        Evaluate();
+    });
+}
+
+void RuleEngine::CheckBattery() {
+    int level = 0;
+    bool charging = false;
+    bool discharging = false;
+    if (!Board::GetInstance().GetBatteryLevel(level, charging, discharging)) {
+        return;
+    }
+    if (level != battery_level_ || charging != battery_charging_) {
+        battery_level_ = level;
+        battery_charging_ = charging;
+        Notify();
+    }
+}
+
+void RuleEngine::AddTools() {
+    auto& mcp_server = McpServer::GetInstance();
+
+    mcp_server.AddTool("self.rules.list",
+        "List the automation rules that run on the device without the server.",
+        PropertyList(),
+        [this](const PropertyList& properties) -> ReturnValue {
+            return GetRulesJson();
+        });
+
+    mcp_server.AddTool("self.rules.add",
+        "Add an automation rule that runs on the device, or replace the rule of the same name.\n"
+        "When all the conditions become true, the device calls the tool with the arguments once.\n"
+        "Args:\n"
+        "  `rule`: A JSON object, e.g. {\"name\":\"night\",\"when\":[{\"key\":\"time\",\"op\":\"between\",\"value\":\"22:00-07:00\"}],"
+        "\"tool\":\"self.screen.set_brightness\",\"arguments\":{\"brightness\":10}}\n"
+        "  The `key` of a condition is a field of `self.get_device_status` like `battery.level`, or `time`.\n"
+        "  The `op` is one of ==, !=, <, <=, >, >=, between. The value of between is \"HH:MM-HH:MM\" with different start and end, or [min, max].",
+        PropertyList({
+            Property("rule", kPropertyTypeString)
+        }),
+        [this](const PropertyList& properties) -> ReturnValue {
+            std::string error;
+            if (!AddRule(properties["rule"].value<std::string>(), error)) {
+                throw std::runtime_error(error);
+            }
+            Notify();
+            return true;
+        });
+
+    mcp_server.AddTool("self.rules.remove",
+        "Remove an automation rule by name.",
+        PropertyList({
+            Property("name", kPropertyTypeString)
+        }),
+        [this](const PropertyList& properties) -> ReturnValue {
+            auto name = properties["name"].value<std::string>();
+            if (!RemoveRule(name)) {
+                throw std::runtime_error("Rule not found: " + name);
+            }
+            return true;
+        });
+}
+
+static bool ParseTime(const char* text, double& minutes) {
+    int hour = 0, minute = 0;
+    if (sscanf(text, "%d:%d", &hour, &minute) != 2 || hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return false;
+    }
+    minutes = hour * 60 + minute;
+    return true;
+}
+
+bool RuleEngine::ParseRule(const cJSON* json, Rule& rule, std::string& error) {
+    auto name = cJSON_GetObjectItem(json, "name");
+    auto when = cJSON_GetObjectItem(json, "when");
+    auto tool = cJSON_GetObjectItem(json, "tool");
+    auto arguments = cJSON_GetObjectItem(json, "arguments");
+    if (!cJSON_IsString(name) || !cJSON_IsArray(when) || cJSON_GetArraySize(when) == 0 || !cJSON_IsString(tool)) {
+        error = "Rule requires name, when and tool";
+        return false;
+    }
+    if (arguments != nullptr && !cJSON_IsObject(arguments)) {
+        error = "Rule arguments must be an object";
+        return false;
+    }
+    if (!McpServer::GetInstance().HasTool(tool->valuestring)) {
+        error = std::string("Unknown tool: ") + tool->valuestring;
+        return false;
+    }
+    rule.name = name->valuestring;
+    rule.tool = tool->valuestring;
+
+    cJSON* item = nullptr;
+    cJSON_ArrayForEach(item, when) {
+        auto key = cJSON_GetObjectItem(item, "key");
+        auto op = cJSON_GetObjectItem(item, "op");
+        auto value = cJSON_GetObjectItem(item, "value");
+        if (!cJSON_IsString(key) || !cJSON_IsString(op) || value == nullptr) {
+            error = "Condition requires key, op and value";
+            return false;
+        }
+
+        RuleCondition condition;
+        std::string op_str = op->valuestring;
+        if (op_str == "==") {
+            condition.op = kRuleOperatorEqual;
+        } else if (op_str == "!=") {
+            condition.op = kRuleOperatorNotEqual;
+        } else if (op_str == "<") {
+            condition.op = kRuleOperatorLess;
+        } else if (op_str == "<=") {
+            condition.op = kRuleOperatorLessEqual;
+        } else if (op_str == ">") {
+            condition.op = kRuleOperatorGreater;
+        } else if (op_str == ">=") {
+            condition.op = kRuleOperatorGreaterEqual;
+        } else if (op_str == "between") {
+            condition.op = kRuleOperatorBetween;
+        } else {
+            error = "Unknown op: " + op_str;
+            return false;
+        }
+
+        std::string key_str = key->valuestring;
+        bool valid = true;
+        if (key_str == "time") {
+            condition.is_time = true;
+            if (condition.op == kRuleOperatorBetween) {
+                auto separator = cJSON_IsString(value) ? strchr(value->valuestring, '-') : nullptr;
+                valid = separator != nullptr && ParseTime(value->valuestring, condition.number) &&
+                    ParseTime(separator + 1, condition.number_end);
+                if (valid && condition.number == condition.number_end) {
+                    // An empty range would never match, use two conditions or none for all day
+                    error = "Time range start and end must differ";
+                    return false;
+                }
+            } else {
+                valid = cJSON_IsString(value) && ParseTime(value->valuestring, condition.number);
+            }
+        } else {
+            size_t start = 0;
+            while (start <= key_str.size()) {
+                auto end = key_str.find('.', start);
+                if (end == std::string::npos) {
+                    end = key_str.size();
+                }
+                condition.path.push_back(key_str.substr(start, end - start));
+                start = end + 1;
+            }
+            if (condition.op == kRuleOperatorBetween) {
+                valid = cJSON_IsArray(value) && cJSON_GetArraySize(value) == 2 &&
+                    cJSON_IsNumber(cJSON_GetArrayItem(value, 0)) && cJSON_IsNumber(cJSON_GetArrayItem(value, 1));
+                if (valid) {
+                    condition.number = cJSON_GetArrayItem(value, 0)->valuedouble;
+                    condition.number_end = cJSON_GetArrayItem(value, 1)->valuedouble;
+                }
+            } else if (cJSON_IsNumber(value)) {
+                condition.number = value->valuedouble;
+            } else if (cJSON_IsBool(value)) {
+                condition.number = cJSON_IsTrue(value) ? 1 : 0;
+            } else if (cJSON_IsString(value)) {
+                // Strings are only compared for equality
+                condition.is_string = true;
+                condition.text = value->valuestring;
+                valid = condition.op == kRuleOperatorEqual || condition.op == kRuleOperatorNotEqual;
+            } else {
+                valid = false;
+            }
+        }
+        if (!valid) {
+            error = "Invalid value for " + key_str + " " + op_str;
+            return false;
+        }
+        rule.conditions.push_back(std::move(condition));
+    }
+
+    rule.arguments.reset(arguments != nullptr ? cJSON_Duplicate(arguments, true) : cJSON_CreateObject());
+    return true;
+}
+
+bool RuleEngine::AddRule(const std::string& rule_json, std::string& error) {
+    auto json = cJSON_Parse(rule_json.c_str());
+    if (!cJSON_IsObject(json)) {
+        cJSON_Delete(json);
+        error = "Invalid rule JSON";
+        return false;
+    }
+    Rule rule;
+    if (!ParseRule(json, rule, error)) {
+        cJSON_Delete(json);
+        return false;
+    }
+    char* serialized = cJSON_PrintUnformatted(json);
+    std::string normalized = serialized;
+    cJSON_free(serialized);
+    cJSON_Delete(json);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t index = 0;
+    while (index < rules_.size() && rules_[index].name != rule.name) {
+        index++;
+    }
+    size_t total_size = normalized.size() + 2;
+    for (size_t i = 0; i < rule_jsons_.size(); i++) {
+        if (i != index) {
+            total_size += rule_jsons_[i].size() + 1;
+        }
+    }
+    if (index == rules_.size() && rules_.size() >= MAX_RULES) {
+        error = "Too many rules";
+    } else if (total_size > MAX_RULES_JSON_SIZE) {
+        error = "Rules are too large to save";
+    }
+    if (!error.empty()) {
+        return false;
+    }
+
+    if (index == rules_.size()) {
+        rules_.push_back(std::move(rule));
+        rule_jsons_.push_back(std::move(normalized));
+    } else {
+        rules_[index] = std::move(rule);
+        rule_jsons_[index] = std::move(normalized);
+    }
+    SaveRules();
+    ESP_LOGI(TAG, "Rule added: %s", rules_[index].name.c_str());
+    return true;
+}
+
+bool RuleEngine::RemoveRule(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < rules_.size(); i++) {
+        if (rules_[i].name == name) {
+            rules_.erase(rules_.begin() + i);
+            rule_jsons_.erase(rule_jsons_.begin() + i);
+            SaveRules();
+            ESP_LOGI(TAG, "Rule removed: %s", name.c_str());
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string RuleEngine::GetRulesJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string json = "[";
+    for (const auto& rule_json : rule_jsons_) {
+        json += rule_json;
+        json += ',';
+    }
+    if (json.back() == ',') {
+        json.pop_back();
+    }
+    json += ']';
+    return json;
+}
+
+void RuleEngine::LoadRules() {
+    Settings settings("rules", false);
+    auto rules_json = settings.GetString("rules");
+    if (rules_json.empty()) {
+        return;
+    }
+    auto json = cJSON_Parse(rules_json.c_str());
+    if (!cJSON_IsArray(json)) {
+        ESP_LOGE(TAG, "Invalid saved rules");
+        cJSON_Delete(json);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ClearRules();
+    cJSON* item = nullptr;
+    cJSON_ArrayForEach(item, json) {
+        Rule rule;
+        std::string error;
+        char* serialized = cJSON_PrintUnformatted(item);
+        if (ParseRule(item, rule, error)) {
+            rules_.push_back(std::move(rule));
+            rule_jsons_.push_back(serialized);
+        } else {
+            // The tool may be gone after a firmware update, keep the other rules
+            ESP_LOGW(TAG, "Skip saved rule %s: %s", serialized, error.c_str());
+        }
+        cJSON_free(serialized);
+    }
+    cJSON_Delete(json);
+    ESP_LOGI(TAG, "Loaded %u rules", (unsigned)rules_.size());
+}
+
+void RuleEngine::SaveRules() {
+    std::string json = "[";
+    for (const auto& rule_json : rule_jsons_) {
+        json += rule_json;
+        json += ',';
+    }
+    if (json.back() == ',') {
+        json.pop_back();
+    }
+    json += ']';
+    Settings settings("rules", true);
+    settings.SetString("rules", json);
+}
+
+void RuleEngine::ClearRules() {
+    rules_.clear();
+    rule_jsons_.clear();
+}
+
+bool RuleEngine::EvaluateCondition(const RuleCondition& condition, const cJSON* status, int minute_of_day) {
+    double value = 0;
+    if (condition.is_time) {
+        if (minute_of_day < 0) {
+            return false;
+        }
+        value = minute_of_day;
+        if (condition.op == kRuleOperatorBetween) {
+            // The range may wrap around midnight, e.g. 22:00-07:00
+            if (condition.number <= condition.number_end) {
+                return value >= condition.number && value < condition.number_end;
+            }
+            return value >= condition.number || value < condition.number_end;
+        }
+    } else {
+        const cJSON* item = status;
+        for (const auto& name : condition.path) {
+            item = cJSON_IsObject(item) ? cJSON_GetObjectItem(item, name.c_str()) : nullptr;
+        }
+        if (condition.is_string) {
+            if (!cJSON_IsString(item)) {
+                return false;
+            }
+            bool equal = condition.text == item->valuestring;
+            return condition.op == kRuleOperatorEqual ? equal : !equal;
+        }
+        if (cJSON_IsNumber(item)) {
+            value = item->valuedouble;
+        } else if (cJSON_IsBool(item)) {
+            value = cJSON_IsTrue(item) ? 1 : 0;
+        } else {
+            return false;
+        }
+        if (condition.op == kRuleOperatorBetween) {
+            return value >= condition.number && value <= condition.number_end;
+        }
+    }
+
+    switch (condition.op) {
+        case kRuleOperatorEqual:
+            return value == condition.number;
+        case kRuleOperatorNotEqual:
+            return value != condition.number;
+        case kRuleOperatorLess:
+            return value < condition.number;
+        case kRuleOperatorLessEqual:
+            return value <= condition.number;
+        case kRuleOperatorGreater:
+            return value > condition.number;
+        case kRuleOperatorGreaterEqual:
+            return value >= condition.number;
+        default:
+            return false;
+    }
+}
+
+void RuleEngine::Evaluate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rules_.empty()) {
+        return;
+    }
+    int64_t start_time = esp_timer_get_time();
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    // The time conditions stay false until the clock is synchronized
+    bool time_valid = tm.tm_year >= 2025 - 1900;
+    int minute_of_day = time_valid ? tm.tm_hour * 60 + tm.tm_min : -1;
+
+    bool has_time = false;
+    bool has_status = false;
+    for (const auto& rule : rules_) {
+        for (const auto& condition : rule.conditions) {
+            has_time |= condition.is_time;
+            has_status |= !condition.is_time;
+        }
+    }
+    // Parse the status once for all the rules
+    cJSON* status = has_status ? cJSON_Parse(Board::GetInstance().GetDeviceStatusJson().c_str()) : nullptr;
+
+    int fired = 0;
+    for (auto& rule : rules_) {
+        bool matched = true;
+        for (const auto& condition : rule.conditions) {
+            if (!EvaluateCondition(condition, status, minute_of_day)) {
+                matched = false;
+                break;
+            }
+        }
+        if (matched && !rule.matched) {
+            ESP_LOGI(TAG, "Rule %s matched, call %s", rule.name.c_str(), rule.tool.c_str());
+            McpServer::GetInstance().CallToolLocally(rule.tool, rule.arguments.get());
+            fired++;
+        }
+        rule.matched = matched;
+    }
+    cJSON_Delete(status);
+
+    if (has_time) {
+        ScheduleTimeCheck(minute_of_day, tm.tm_sec);
+    }
+    ESP_LOGD(TAG, "Evaluated %u rules in %d us, %d fired", (unsigned)rules_.size(),
+        (int)(esp_timer_get_time() - start_time), fired);
+}
+
+void RuleEngine::ScheduleTimeCheck(int minute_of_day, int second) {
+    int64_t delay_us;
+    if (minute_of_day < 0) {
+        // Check again after the clock is synchronized
+        delay_us = 60 * 1000000LL;
+    } else {
+        // Wake up at the nearest minute where a time condition can change
+        int delta = MINUTES_PER_DAY;
+        auto update = [&](int boundary) {
+            int minutes = ((boundary - minute_of_day) % MINUTES_PER_DAY + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+            if (minutes > 0 && minutes < delta) {
+                delta = minutes;
+            }
+        };
+        for (const auto& rule : rules_) {
+            for (const auto& condition : rule.conditions) {
+                if (!condition.is_time) {
+                    continue;
+                }
+                update((int)condition.number);
+                update((int)(condition.op == kRuleOperatorBetween ? condition.number_end : condition.number + 1));
+            }
+        }
+        delay_us = (delta * 60LL - second) * 1000000LL;
+    }
+    esp_timer_stop(time_timer_);
+    esp_timer_start_once(time_timer_, delay_us);
+}
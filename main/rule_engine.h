@@ -0,0 +1,91 @@
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+#include <cJSON.h>
+#include <esp_timer.h>
+
+/*
+ * 本地规则引擎
+ *
+ * 规则在设备状态 (GetDeviceStatusJson) 或时间满足条件时直接调用已注册的 MCP 工具，
+ * 不需要服务器往返。规则保存在 Settings 中，通过 self.rules.* 工具管理。
+ * 只在状态可能变化时求值（工具调用、电量变化、时间到达条件边界），不轮询。
+ */
+enum RuleOperator {
+    kRuleOperatorEqual,
+    kRuleOperatorNotEqual,
+    kRuleOperatorLess,
+    kRuleOperatorLessEqual,
+    kRuleOperatorGreater,
+    kRuleOperatorGreaterEqual,
+    kRuleOperatorBetween
+};
+
+// A condition over one device status field, or over the local time when the key is "time"
+struct RuleCondition {
+    std::vector<std::string> path;  // "battery.level" -> {"battery", "level"}
+    RuleOperator op;
+    bool is_time = false;
+    bool is_string = false;
+    double number = 0;  // Number, bool (0/1), or minutes of the day for time
+    double number_end = 0;  // End of a between range
+    std::string text;
+};
+
+struct Rule {
+    std::string name;
+    std::vector<RuleCondition> conditions;  // All must hold
+    std::string tool;
+    std::unique_ptr<cJSON, decltype(&cJSON_Delete)> arguments{nullptr, cJSON_Delete};
+    bool matched = false;  // Fires only when the conditions become true
+};
+
+class RuleEngine {
+public:
+    static RuleEngine& GetInstance() {
+        static RuleEngine instance;
+        return instance;
+    }
+    // Delete copy constructor and assignment operator
+    RuleEngine(const RuleEngine&) = delete;
+    RuleEngine& operator=(const RuleEngine&) = delete;
+
+    // Load the rules and add the self.rules.* tools, after the common tools are added
+    void Initialize();
+    // The device status may have changed, evaluate the rules on the main loop
+    void Notify();
+    // Called by the clock timer, notifies when the battery level or charging changes
+    void CheckBattery();
+
+private:
+    RuleEngine();
+    ~RuleEngine();
+
+    void AddTools();
+    bool ParseRule(const cJSON* json, Rule& rule, std::string& error);
+    bool AddRule(const std::string& rule_json, std::string& error);
+    bool RemoveRule(const std::string& name);
+    std::string GetRulesJson();
+    void LoadRules();
+    void SaveRules();
+    void ClearRules();
+    void Evaluate();
+    bool EvaluateCondition(const RuleCondition& condition, const cJSON* status, int minute_of_day);
+    void ScheduleTimeCheck(int minute_of_day, int second);
+
+    std::mutex mutex_;
+    std::vector<Rule> rules_;
+    std::vector<std::string> rule_jsons_;  // Serialized form of each rule, for saving and listing
+    std::atomic<bool> evaluation_pending_{false};
+    esp_timer_handle_t time_timer_ = nullptr;
+    int battery_level_ = -1;
+    bool battery_charging_ = false;
+};
+
+#endif // RULE_ENGINE_H